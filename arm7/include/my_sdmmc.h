@@ -135,6 +135,7 @@ int my_sdmmc_cardinserted();
 int my_sdmmc_sdcard_init();
 int my_sdmmc_nand_init();
 void my_sdmmc_get_cid(int devicenumber, u32 *cid);
+void my_sdmmc_nand_cid_early(u32 *cid);
 
 static inline void sdmmc_nand_cid( u32 *cid) {
     my_sdmmc_get_cid(MMC_DEVICE_NAND,cid);
@@ -0,0 +1,96 @@
+#include <nds.h>
+
+// Bulk AES-CTR on the DSi AES engine for the ARM9, which otherwise does
+// NAND crypto in software. Works in place on a buffer in main RAM.
+
+#define AES_KEYSLOT_NAND 3
+
+// Interrupts are off for a whole request, must match AES_HW_MAX_BLOCKS in
+// arm9/source/crypto.c
+#define AES_CTR_MAX_BLOCKS 0x400
+#define REG_AES_NORMALKEY(slot) ((vu32*)(0x04004440 + (slot) * 0x30))
+
+#define AES_WRFIFO_COUNT(cnt) ((cnt) & 0x1F)
+#define AES_RDFIFO_COUNT(cnt) (((cnt) >> 5) & 0x1F)
+
+// Must match aes_ctr_msg_t in arm9/source/crypto.c
+typedef struct {
+	u32 *buffer;
+	u32 blocks;
+	u32 ctr[4];
+	u32 key[4];
+	u32 keyslot;
+} AesCtrMsg;
+
+static int aesCtr(const AesCtrMsg *msg) {
+	if (!(isDSiMode() || (REG_SCFG_EXT & BIT(17))))
+		return 1;
+	if (msg->blocks == 0 || msg->blocks > AES_CTR_MAX_BLOCKS || msg->keyslot > 3)
+		return 1;
+
+	// The NAND keyslot is already set up by the system, anything else
+	// gets the normal key from the ARM9
+	if (msg->keyslot != AES_KEYSLOT_NAND) {
+		for (int i = 0; i < 4; i++)
+			REG_AES_NORMALKEY(msg->keyslot)[i] = msg->key[i];
+	}
+
+	REG_AES_CNT = ( AES_CNT_MODE(2) |
+					AES_WRFIFO_FLUSH |
+					AES_RDFIFO_FLUSH |
+					AES_CNT_KEY_APPLY |
+					AES_CNT_KEYSLOT(msg->keyslot)
+					);
+
+	for (int i = 0; i < 4; i++) REG_AES_IV[i] = msg->ctr[i];
+	REG_AES_BLKCNT = msg->blocks << 16;
+	REG_AES_CNT |= 0x80000000;
+
+	// Keep the input FIFO topped up a block at a time while draining the
+	// output, the output never gets ahead of the input so in place is fine
+	u32 words = msg->blocks * 4;
+	u32 *in = msg->buffer, *out = msg->buffer;
+	u32 written = 0, read = 0, idle = 0;
+	while (read < words) {
+		u32 cnt = REG_AES_CNT;
+		bool progress = false;
+
+		if (written < words && AES_WRFIFO_COUNT(cnt) <= 12) {
+			REG_AES_WRFIFO = in[written++];
+			REG_AES_WRFIFO = in[written++];
+			REG_AES_WRFIFO = in[written++];
+			REG_AES_WRFIFO = in[written++];
+			progress = true;
+		}
+
+		if (AES_RDFIFO_COUNT(cnt) >= 4) {
+			out[read++] = REG_AES_RDFIFO;
+			out[read++] = REG_AES_RDFIFO;
+			out[read++] = REG_AES_RDFIFO;
+			out[read++] = REG_AES_RDFIFO;
+			progress = true;
+		}
+
+		// Don't hang the ARM7 if the engine is disabled or stuck
+		if (progress)
+			idle = 0;
+		else if (++idle > 0x100000)
+			return 1;
+	}
+
+	return 0;
+}
+
+//---------------------------------------------------------------------------------
+void aesCtrMsgHandler(int bytes, void *user_data) {
+//---------------------------------------------------------------------------------
+	AesCtrMsg msg;
+
+	fifoGetDatamsg(FIFO_USER_08, bytes, (u8*)&msg);
+
+	int oldIME = enterCriticalSection();
+	int result = aesCtr(&msg);
+	leaveCriticalSection(oldIME);
+
+	fifoSendValue32(FIFO_USER_08, result);
+}
@@ -36,6 +36,7 @@
 
 void my_installSystemFIFO(void);
 void my_sdmmc_get_cid(int devicenumber, u32 *cid);
+void my_sdmmcRingProcess(void);
 
 u8 my_i2cReadRegister(u8 device, u8 reg);
 u8 my_i2cWriteRegister(u8 device, u8 reg, u8 data);
@@ -53,9 +54,13 @@ void ReturntoDSiMenu() {
 	}
 }
 
+//---------------------------------------------------------------------------------
+volatile u32 vblankCount = 0;
+
 //---------------------------------------------------------------------------------
 void VblankHandler(void) {
 //---------------------------------------------------------------------------------
+	vblankCount++;
 	if(fifoCheckValue32(FIFO_USER_02)) {
 		ReturntoDSiMenu();
 	}
@@ -190,7 +195,7 @@ int main() {
 			exitflag = true;
 		}
 		if (*(u32*)(0x2FFFD0C) == 0x454D4D43) {
-			my_sdmmc_get_cid(true, (u32*)0x2FFD7BC);	// Get eMMC CID
+			my_sdmmc_nand_cid_early((u32*)0x2FFD7BC);	// Get eMMC CID
 			*(u32*)(0x2FFFD0C) = 0;
 		}
 		resyncClock();
@@ -211,7 +216,13 @@ int main() {
 			}
 		}
 
-		swiWaitForVBlank();
+		// Sleep until the next VBlank as before, but wake for SD/NAND requests
+		// from the ARM9 in the meantime
+		u32 frame = vblankCount;
+		do {
+			my_sdmmcRingProcess();
+			swiIntrWait(0, IRQ_VBLANK | IRQ_FIFO_NOT_EMPTY);
+		} while (frame == vblankCount);
 	}
 	return 0;
 }
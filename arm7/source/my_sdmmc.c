@@ -6,10 +6,60 @@
 #include <nds/fifomessages.h>
 
 #include <stddef.h>
+#include <string.h>
+#include "dmaTwl.h"
 
 static struct mmcdevice deviceSD;
 static struct mmcdevice deviceNAND;
 
+#ifdef DATA32_SUPPORT
+#define SDMMC_NDMA_CHANNEL 1
+
+static bool sdmmcUseNdma = false;
+
+// Unaligned buffers go through here a block at a time
+static u32 bounceBuf[512 / 4];
+
+//---------------------------------------------------------------------------------
+static void sdmmc_fifo_read(u32 *dst, u32 size) {
+//---------------------------------------------------------------------------------
+	// The whole block is already in the FIFO when this is called
+	if (sdmmcUseNdma) {
+		vu32* channel = &(&REG_NDMA0SAD)[7 * SDMMC_NDMA_CHANNEL];
+		channel[0] = SDMMC_BASE + REG_SDFIFO32; //SAD
+		channel[1] = (u32)dst; //DAD
+		channel[3] = size >> 2; //WCNT
+		channel[4] = NDMABCNT_PRESCALER_1 | NDMABCNT_INTERVAL(0); //BCNT
+		channel[6] = NDMACNT_DST_MODE_INCREMENT | NDMACNT_SRC_MODE_FIXED |
+			NDMACNT_PHYSICAL_COUNT_1 | NDMACNT_MODE_IMMEDIATE | NDMACNT_ENABLE;
+		dma_twlWait(SDMMC_NDMA_CHANNEL);
+		return;
+	}
+
+	for (u32 i = 0; i < size; i += 4)
+		*dst++ = sdmmc_read32(REG_SDFIFO32);
+}
+
+//---------------------------------------------------------------------------------
+static void sdmmc_fifo_write(const u32 *src, u32 size) {
+//---------------------------------------------------------------------------------
+	if (sdmmcUseNdma) {
+		vu32* channel = &(&REG_NDMA0SAD)[7 * SDMMC_NDMA_CHANNEL];
+		channel[0] = (u32)src; //SAD
+		channel[1] = SDMMC_BASE + REG_SDFIFO32; //DAD
+		channel[3] = size >> 2; //WCNT
+		channel[4] = NDMABCNT_PRESCALER_1 | NDMABCNT_INTERVAL(0); //BCNT
+		channel[6] = NDMACNT_DST_MODE_FIXED | NDMACNT_SRC_MODE_INCREMENT |
+			NDMACNT_PHYSICAL_COUNT_1 | NDMACNT_MODE_IMMEDIATE | NDMACNT_ENABLE;
+		dma_twlWait(SDMMC_NDMA_CHANNEL);
+		return;
+	}
+
+	for (u32 i = 0; i < size; i += 4)
+		sdmmc_write32(REG_SDFIFO32, *src++);
+}
+#endif
+
 /*mmcdevice *getMMCDevice(int drive) {
     if(drive==0) return &deviceNAND;
     return &deviceSD;
@@ -105,24 +155,17 @@ void my_sdmmc_send_command(struct mmcdevice *ctx, uint32_t cmd, uint32_t args) {
 					if(size >= blkSize)
 					{
 						#ifdef DATA32_SUPPORT
-						if(!((u32)rDataPtr32 & 3))
+						if(!((u32)rDataPtr8 & 3))
 						{
-							for(u32 i = 0; i < blkSize; i += 4)
-							{
-								*rDataPtr32++ = sdmmc_read32(REG_SDFIFO32);
-							}
+							sdmmc_fifo_read((u32*)rDataPtr8, blkSize);
 						}
 						else
 						{
-							for(u32 i = 0; i < blkSize; i += 4)
-							{
-								u32 data = sdmmc_read32(REG_SDFIFO32);
-								*rDataPtr8++ = data;
-								*rDataPtr8++ = data >> 8;
-								*rDataPtr8++ = data >> 16;
-								*rDataPtr8++ = data >> 24;
-							}
+							// The FIFO and NDMA only move whole words
+							sdmmc_fifo_read(bounceBuf, blkSize);
+							memcpy(rDataPtr8, bounceBuf, blkSize);
 						}
+						rDataPtr8 += blkSize;
 						#else
 						if(!((u16)rDataPtr16 & 1))
 						{
@@ -162,24 +205,16 @@ void my_sdmmc_send_command(struct mmcdevice *ctx, uint32_t cmd, uint32_t args) {
 					if(size >= blkSize)
 					{
 						#ifdef DATA32_SUPPORT
-						if(!((u32)tDataPtr32 & 3))
+						if(!((u32)tDataPtr8 & 3))
 						{
-							for(u32 i = 0; i < blkSize; i += 4)
-							{
-								sdmmc_write32(REG_SDFIFO32, *tDataPtr32++);
-							}
+							sdmmc_fifo_write((const u32*)tDataPtr8, blkSize);
 						}
 						else
 						{
-							for(u32 i = 0; i < blkSize; i += 4)
-							{
-								u32 data = *tDataPtr8++;
-								data |= (u32)*tDataPtr8++ << 8;
-								data |= (u32)*tDataPtr8++ << 16;
-								data |= (u32)*tDataPtr8++ << 24;
-								sdmmc_write32(REG_SDFIFO32, data);
-							}
+							memcpy(bounceBuf, tDataPtr8, blkSize);
+							sdmmc_fifo_write(bounceBuf, blkSize);
 						}
+						tDataPtr8 += blkSize;
 						#else
 						if(!((u16)tDataPtr16 & 1))
 						{
@@ -258,6 +293,10 @@ void my_sdmmc_controller_init( bool force_init ) {
 
     if (!force_init && my_sdmmc_controller_initialised && my_nand_controller_initialised) return;
 
+#ifdef DATA32_SUPPORT
+    sdmmcUseNdma = isDSiMode() || (REG_SCFG_EXT & BIT(16));
+#endif
+
     if(!my_sdmmc_controller_initialised) {
         deviceSD.isSDHC = 0;
         deviceSD.SDOPT = 0;
@@ -542,6 +581,68 @@ void my_sdmmc_get_cid(int devicenumber, u32 *cid) {
     leaveCriticalSection(oldIME);
 }
 
+// Must match arm9/source/my_sd.c
+#define SDMMC_RING_SIZE 16
+#define SDMMC_RING_KICK 0x52494E47 // 'RING'
+
+enum {
+    RING_IDLE = 0,
+    RING_PENDING,
+    RING_DONE
+};
+
+typedef struct {
+    vu32 state;
+    u32 type;
+    u32 sector;
+    u32 count;
+    void *buffer;
+    vs32 result;
+    u32 ticket;
+    u32 reserved;
+} SdmmcRingSlot;
+
+static SdmmcRingSlot *volatile sdmmcRing = NULL;
+static u32 sdmmcRingHead = 0;
+
+//---------------------------------------------------------------------------------
+static int my_sdmmc_request(u32 type, u32 sector, u32 count, void *buffer) {
+//---------------------------------------------------------------------------------
+    switch (type) {
+    case SDMMC_SD_READ_SECTORS:
+        return my_sdmmc_readsectors(&deviceSD, sector, count, buffer);
+    case SDMMC_SD_WRITE_SECTORS:
+        return my_sdmmc_writesectors(&deviceSD, sector, count, buffer);
+    case SDMMC_NAND_READ_SECTORS:
+        return my_sdmmc_readsectors(&deviceNAND, sector, count, buffer);
+    case SDMMC_NAND_WRITE_SECTORS:
+        return my_sdmmc_writesectors(&deviceNAND, sector, count, buffer);
+    }
+
+    return -1;
+}
+
+//---------------------------------------------------------------------------------
+void my_sdmmcRingProcess(void) {
+//---------------------------------------------------------------------------------
+    SdmmcRingSlot *ring = sdmmcRing;
+    if (!ring)
+        return;
+
+    // The ARM9 fills slots in order, so stop at the first one it hasn't
+    while (ring[sdmmcRingHead].state == RING_PENDING) {
+        SdmmcRingSlot *slot = &ring[sdmmcRingHead];
+
+        // One request at a time so the other IRQs get a look in between
+        int oldIME = enterCriticalSection();
+        slot->result = my_sdmmc_request(slot->type, slot->sector, slot->count, slot->buffer);
+        leaveCriticalSection(oldIME);
+
+        slot->state = RING_DONE;
+        sdmmcRingHead = (sdmmcRingHead + 1) % SDMMC_RING_SIZE;
+    }
+}
+
 //---------------------------------------------------------------------------------
 void my_sdmmcMsgHandler(int bytes, void *user_data) {
 //---------------------------------------------------------------------------------
@@ -550,6 +651,12 @@ void my_sdmmcMsgHandler(int bytes, void *user_data) {
 
     fifoGetDatamsg(FIFO_SDMMC, bytes, (u8*)&msg);
 
+    // Ring requests are picked up by the main loop, this just wakes it
+    if (msg.type == SDMMC_RING_KICK) {
+        sdmmcRing = (SdmmcRingSlot *)msg.sdParams.buffer;
+        return;
+    }
+
     int oldIME = enterCriticalSection();
     switch (msg.type) {
 
@@ -586,6 +693,19 @@ int my_sdmmc_sd_startup() {
     return my_sdmmc_sdcard_init();
 }
 
+//---------------------------------------------------------------------------------
+void my_sdmmc_nand_cid_early(u32 *cid) {
+//---------------------------------------------------------------------------------
+    // The ARM9 asks for this while it's still mounting the SD card, before
+    // it has started the NAND itself
+    int oldIME = enterCriticalSection();
+    if (deviceNAND.total_size == 0 && sdmmc_read16(REG_SDSTATUS0) != 0)
+        my_sdmmc_nand_startup();
+    leaveCriticalSection(oldIME);
+
+    my_sdmmc_get_cid(MMC_DEVICE_NAND, cid);
+}
+
 //---------------------------------------------------------------------------------
 void my_sdmmcValueHandler(u32 value, void* user_data) {
 //---------------------------------------------------------------------------------
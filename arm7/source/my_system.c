@@ -36,6 +36,7 @@ void powerValueHandler(u32 value, void* user_data);
 void my_sdmmcMsgHandler(int bytes, void *user_data);
 void my_sdmmcValueHandler(u32 value, void* user_data);
 void firmwareMsgHandler(int bytes, void *user_data);
+void aesCtrMsgHandler(int bytes, void *user_data);
 
 //---------------------------------------------------------------------------------
 void my_installSystemFIFO(void) {
@@ -47,6 +48,7 @@ void my_installSystemFIFO(void) {
 		fifoSetDatamsgHandler(FIFO_SDMMC, my_sdmmcMsgHandler, 0);
 	//}
 	fifoSetDatamsgHandler(FIFO_FIRMWARE, firmwareMsgHandler, 0);
+	fifoSetDatamsgHandler(FIFO_USER_08, aesCtrMsgHandler, 0);
 	
 }
 
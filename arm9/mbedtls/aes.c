@@ -18,11 +18,13 @@
 #endif
 
 // it's interesting they mix unsigned char with uint32_t
+// FT1..FT3 are just FT0 rotated, and a rotated operand is free on ARM,
+// so only FT0 is kept, which saves 3KB of DTCM and 3 base registers
 DTCM_BSS static unsigned char FSb[256];
 DTCM_BSS static uint32_t FT0[256];
-DTCM_BSS static uint32_t FT1[256];
-DTCM_BSS static uint32_t FT2[256];
-DTCM_BSS static uint32_t FT3[256];
+#define FT1(i) ROR32(FT0[i], 24)
+#define FT2(i) ROR32(FT0[i], 16)
+#define FT3(i) ROR32(FT0[i], 8)
 
 // AES-CTR/CCM only uses encrypt, so R tables are not used
 #define NO_R_TABLES
@@ -42,6 +44,7 @@ static uint32_t RCON[256];
 #define ROTL8(x) ( ( x << 8 ) & 0xFFFFFFFF ) | ( x >> 24 )
 #define XTIME(x) ( ( x << 1 ) ^ ( ( x & 0x80 ) ? 0x1B : 0x00 ) )
 #define MUL(x,y) ( ( x && y ) ? pow[(log[x]+log[y]) % 255] : 0 )
+#define ROR32(x,n) ( ( (x) >> (n) ) | ( (x) << (32 - (n)) ) )
 
 void aes_gen_tables(void)
 {
@@ -110,10 +113,6 @@ void aes_gen_tables(void)
 			((uint32_t)x << 16) ^
 			((uint32_t)z << 24);
 
-		FT1[i] = ROTL8(FT0[i]);
-		FT2[i] = ROTL8(FT1[i]);
-		FT3[i] = ROTL8(FT2[i]);
-
 		x = RSb[i];
 
 		RT0[i] = ((uint32_t)MUL(0x0E, x)) ^
@@ -170,24 +169,24 @@ void aes_set_key_enc_128_be(uint32_t rk[RK_LEN], const unsigned char *key) {
 #define AES_FROUND(X0,X1,X2,X3,Y0,Y1,Y2,Y3)     \
 {                                               \
     X0 = *RK++ ^ FT0[ ( Y0       ) & 0xFF ] ^   \
-                 FT1[ ( Y1 >>  8 ) & 0xFF ] ^   \
-                 FT2[ ( Y2 >> 16 ) & 0xFF ] ^   \
-                 FT3[ ( Y3 >> 24 ) & 0xFF ];    \
+                 FT1( ( Y1 >>  8 ) & 0xFF ) ^   \
+                 FT2( ( Y2 >> 16 ) & 0xFF ) ^   \
+                 FT3( ( Y3 >> 24 ) & 0xFF );    \
                                                 \
     X1 = *RK++ ^ FT0[ ( Y1       ) & 0xFF ] ^   \
-                 FT1[ ( Y2 >>  8 ) & 0xFF ] ^   \
-                 FT2[ ( Y3 >> 16 ) & 0xFF ] ^   \
-                 FT3[ ( Y0 >> 24 ) & 0xFF ];    \
+                 FT1( ( Y2 >>  8 ) & 0xFF ) ^   \
+                 FT2( ( Y3 >> 16 ) & 0xFF ) ^   \
+                 FT3( ( Y0 >> 24 ) & 0xFF );    \
                                                 \
     X2 = *RK++ ^ FT0[ ( Y2       ) & 0xFF ] ^   \
-                 FT1[ ( Y3 >>  8 ) & 0xFF ] ^   \
-                 FT2[ ( Y0 >> 16 ) & 0xFF ] ^   \
-                 FT3[ ( Y1 >> 24 ) & 0xFF ];    \
+                 FT1( ( Y3 >>  8 ) & 0xFF ) ^   \
+                 FT2( ( Y0 >> 16 ) & 0xFF ) ^   \
+                 FT3( ( Y1 >> 24 ) & 0xFF );    \
                                                 \
     X3 = *RK++ ^ FT0[ ( Y3       ) & 0xFF ] ^   \
-                 FT1[ ( Y0 >>  8 ) & 0xFF ] ^   \
-                 FT2[ ( Y1 >> 16 ) & 0xFF ] ^   \
-                 FT3[ ( Y2 >> 24 ) & 0xFF ];    \
+                 FT1( ( Y0 >>  8 ) & 0xFF ) ^   \
+                 FT2( ( Y1 >> 16 ) & 0xFF ) ^   \
+                 FT3( ( Y2 >> 24 ) & 0xFF );    \
 }
 
 DTCM_BSS uint32_t X0, X1, X2, X3, Y0, Y1, Y2, Y3;
@@ -250,3 +249,92 @@ ITCM_CODE void aes_encrypt_128_be(const uint32_t rk[RK_LEN],
 	PUT_UINT32_BE(X3, output, 0);
 }
 
+
+// AES-CTR over many blocks in one call, for NAND and boot2 crypto
+// in/out are 32 bit aligned, ctr is in the same word order the callers
+// used with aes_encrypt_128_be and is left pointing past the last block
+//
+// Taking the counter byte reversed and putting the keystream byte reversed
+// is what makes the BE variant, instead of swapping every block, the first
+// round reads the bytes of the unswapped words in reverse, and the last round
+// builds its output bytes already swapped, so only the first and last round
+// keys need swapping, once per call
+#define BSWAP32(x) ( ( (x) >> 24 ) | ( ( (x) >> 8 ) & 0xFF00 ) | \
+	( ( (x) << 8 ) & 0xFF0000 ) | ( (x) << 24 ) )
+
+#define AES_FROUND_SWAPPED(X0,X1,X2,X3,W0,W1,W2,W3) \
+{                                               \
+    X0 = *RK++ ^ FT0[ ( W0 >> 24 )        ] ^   \
+                 FT1( ( W1 >> 16 ) & 0xFF ) ^   \
+                 FT2( ( W2 >>  8 ) & 0xFF ) ^   \
+                 FT3( ( W3       ) & 0xFF );    \
+                                                \
+    X1 = *RK++ ^ FT0[ ( W1 >> 24 )        ] ^   \
+                 FT1( ( W2 >> 16 ) & 0xFF ) ^   \
+                 FT2( ( W3 >>  8 ) & 0xFF ) ^   \
+                 FT3( ( W0       ) & 0xFF );    \
+                                                \
+    X2 = *RK++ ^ FT0[ ( W2 >> 24 )        ] ^   \
+                 FT1( ( W3 >> 16 ) & 0xFF ) ^   \
+                 FT2( ( W0 >>  8 ) & 0xFF ) ^   \
+                 FT3( ( W1       ) & 0xFF );    \
+                                                \
+    X3 = *RK++ ^ FT0[ ( W3 >> 24 )        ] ^   \
+                 FT1( ( W0 >> 16 ) & 0xFF ) ^   \
+                 FT2( ( W1 >>  8 ) & 0xFF ) ^   \
+                 FT3( ( W2       ) & 0xFF );    \
+}
+
+#define AES_FSB_SWAPPED(K,Y0,Y1,Y2,Y3)            \
+    ( K ^ ((uint32_t)FSb[(Y0) & 0xFF] << 24) ^    \
+        ((uint32_t)FSb[(Y1 >> 8) & 0xFF] << 16) ^ \
+        ((uint32_t)FSb[(Y2 >> 16) & 0xFF] << 8) ^ \
+        ((uint32_t)FSb[(Y3 >> 24) & 0xFF]) )
+
+ITCM_CODE void aes_ctr_crypt_128_be(const uint32_t rk[RK_LEN], uint32_t ctr[4],
+	const uint32_t *input, uint32_t *output, unsigned count)
+{
+	const uint32_t K0 = BSWAP32(rk[0]), K1 = BSWAP32(rk[1]);
+	const uint32_t K2 = BSWAP32(rk[2]), K3 = BSWAP32(rk[3]);
+	const uint32_t L0 = BSWAP32(rk[40]), L1 = BSWAP32(rk[41]);
+	const uint32_t L2 = BSWAP32(rk[42]), L3 = BSWAP32(rk[43]);
+	uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+	uint32_t x0, x1, x2, x3, y0, y1, y2, y3;
+	const uint32_t *RK;
+
+	while (count-- > 0) {
+		RK = rk + 4;
+
+		// first round straight off the counter words
+		x0 = c3 ^ K0;
+		x1 = c2 ^ K1;
+		x2 = c1 ^ K2;
+		x3 = c0 ^ K3;
+		AES_FROUND_SWAPPED(y0, y1, y2, y3, x0, x1, x2, x3);
+
+		AES_FROUND(x0, x1, x2, x3, y0, y1, y2, y3);
+		AES_FROUND(y0, y1, y2, y3, x0, x1, x2, x3);
+		AES_FROUND(x0, x1, x2, x3, y0, y1, y2, y3);
+		AES_FROUND(y0, y1, y2, y3, x0, x1, x2, x3);
+		AES_FROUND(x0, x1, x2, x3, y0, y1, y2, y3);
+		AES_FROUND(y0, y1, y2, y3, x0, x1, x2, x3);
+		AES_FROUND(x0, x1, x2, x3, y0, y1, y2, y3);
+		AES_FROUND(y0, y1, y2, y3, x0, x1, x2, x3);
+
+		// last round lands in output order, XOR it in a word at a time
+		output[3] = input[3] ^ AES_FSB_SWAPPED(L0, y0, y1, y2, y3);
+		output[2] = input[2] ^ AES_FSB_SWAPPED(L1, y1, y2, y3, y0);
+		output[1] = input[1] ^ AES_FSB_SWAPPED(L2, y2, y3, y0, y1);
+		output[0] = input[0] ^ AES_FSB_SWAPPED(L3, y3, y0, y1, y2);
+		input += 4;
+		output += 4;
+
+		if (++c0 == 0 && ++c1 == 0 && ++c2 == 0)
+			++c3;
+	}
+
+	ctr[0] = c0;
+	ctr[1] = c1;
+	ctr[2] = c2;
+	ctr[3] = c3;
+}
@@ -30,3 +30,5 @@ void aes_set_key_enc_128_be(uint32_t rk[RK_LEN], const unsigned char *key);
 
 void aes_encrypt_128_be(const uint32_t rk[RK_LEN], const unsigned char input[16], unsigned char output[16]);
 
+// in/out must be aligned to 32 bit, ctr is advanced by count
+void aes_ctr_crypt_128_be(const uint32_t rk[RK_LEN], uint32_t ctr[4], const uint32_t *input, uint32_t *output, unsigned count);
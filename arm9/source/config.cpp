@@ -1,6 +1,7 @@
 #include "config.h"
 
 #include "driveOperations.h"
+#include "imgio.h"
 
 #include <nds.h>
 
@@ -40,6 +41,12 @@ Config::Config() {
 	_languageIniPath = ini.GetString("GODMODE9I", "LANGUAGE_INI_PATH", defaultLanguagePath);
 	_fontPath = ini.GetString("GODMODE9I", "FONT_PATH", "sd:/gm9i/font.frf");
 	_screenSwap = ini.GetInt("GODMODE9I", "SCREEN_SWAP", 0);
+	_imgCacheSectors = ini.GetInt("GODMODE9I", "IMG_CACHE_SECTORS", IMG_CACHE_DEFAULT);
+	_nandReadBatch = ini.GetInt("GODMODE9I", "NAND_READ_BATCH", 0);
+	_ramdriveCompressed = ini.GetInt("GODMODE9I", "RAMDRIVE_COMPRESSED", 0);
+	_ramdriveRestore = ini.GetInt("GODMODE9I", "RAMDRIVE_RESTORE", 0);
+	_bootProfile = ini.GetInt("GODMODE9I", "BOOT_PROFILE", 0);
+	_ioTrace = ini.GetInt("GODMODE9I", "IO_TRACE", 0);
 
 	// If the config doesn't exist, create it
 	if(access(_configPath, F_OK) != 0)
@@ -52,6 +59,12 @@ void Config::save() {
 	ini.SetString("GODMODE9I", "LANGUAGE_INI_PATH", _languageIniPath);
 	ini.SetString("GODMODE9I", "FONT_PATH", _fontPath);
 	ini.SetInt("GODMODE9I", "SCREEN_SWAP", _screenSwap);
+	ini.SetInt("GODMODE9I", "IMG_CACHE_SECTORS", _imgCacheSectors);
+	ini.SetInt("GODMODE9I", "NAND_READ_BATCH", _nandReadBatch);
+	ini.SetInt("GODMODE9I", "RAMDRIVE_COMPRESSED", _ramdriveCompressed);
+	ini.SetInt("GODMODE9I", "RAMDRIVE_RESTORE", _ramdriveRestore);
+	ini.SetInt("GODMODE9I", "BOOT_PROFILE", _bootProfile);
+	ini.SetInt("GODMODE9I", "IO_TRACE", _ioTrace);
 
 	ini.SaveIniFile(_configPath);
 }
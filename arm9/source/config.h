@@ -11,6 +11,12 @@ class Config {
 	std::string _languageIniPath;
 	std::string _fontPath;
 	bool _screenSwap;
+	u32 _imgCacheSectors;
+	u32 _nandReadBatch;
+	bool _ramdriveCompressed;
+	bool _ramdriveRestore;
+	bool _bootProfile;
+	bool _ioTrace;
 
 	static const char *getSystemLanguage(void);
 
@@ -28,6 +34,15 @@ public:
 	bool screenSwap(void) { return _screenSwap; }
 	void screenSwap(bool &screenSwap) { _screenSwap = screenSwap; }
 	u32 screenSwapKey(void) { return _screenSwap ? KEY_TOUCH : 0; }
+
+	u32 imgCacheSectors(void) { return _imgCacheSectors; }
+	u32 nandReadBatch(void) { return _nandReadBatch; }
+
+	bool ramdriveCompressed(void) { return _ramdriveCompressed; }
+	bool ramdriveRestore(void) { return _ramdriveRestore; }
+
+	bool bootProfile(void) { return _bootProfile; }
+	bool ioTrace(void) { return _ioTrace; }
 };
 
 extern Config *config;
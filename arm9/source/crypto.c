@@ -78,7 +78,7 @@ static inline void rol42_128(uint32_t *a){
 	a[0] = (t3 << 10) | (t2 >> 22);
 }
 
-static void dsi_aes_set_key(uint32_t *rk, const uint32_t *console_id, key_mode_t mode) {
+static void dsi_aes_set_key(uint32_t *rk, uint32_t *normal_key, const uint32_t *console_id, key_mode_t mode) {
 	uint32_t key[4];
 	switch (mode) {
 	case NAND:
@@ -113,6 +113,12 @@ static void dsi_aes_set_key(uint32_t *rk, const uint32_t *console_id, key_mode_t
 	rol42_128(key);
 	// iprintf("AES KEY: ROL 42:\n");
 	// print_bytes(key, 16);
+	if (normal_key != NULL) {
+		normal_key[0] = key[0];
+		normal_key[1] = key[1];
+		normal_key[2] = key[2];
+		normal_key[3] = key[3];
+	}
 	aes_set_key_enc_128_be(rk, (uint8_t*)key);
 }
 
@@ -132,12 +138,32 @@ int dsi_sha1_verify(const void *digest_verify, const void *data, unsigned len) {
 }
 
 static uint32_t nand_rk[RK_LEN];
+static uint32_t nand_key[4];
 static uint32_t nand_ctr_iv[4];
 static uint32_t es_rk[RK_LEN];
 static uint32_t boot2_rk[RK_LEN];
 
 static int tables_generated = 0;
 
+// Hardware AES-CTR on the ARM7, see arm7/source/aesctr.c
+// Must match AesCtrMsg there
+typedef struct {
+	uint32_t *buffer;
+	uint32_t blocks;
+	uint32_t ctr[4];
+	uint32_t key[4];
+	uint32_t keyslot;
+} aes_ctr_msg_t;
+
+#define AES_KEYSLOT_NAND 3
+#define AES_KEYSLOT_FREE 0
+// The ARM7 has interrupts off for a whole request, so keep them short
+#define AES_HW_MAX_BLOCKS 0x400
+
+static int nand_hw_keyslot = -1; // -1 when the software path has to be used
+
+static void dsi_nand_hw_probe(void);
+
 void dsi_crypt_init(const uint8_t *console_id_be, const uint8_t *emmc_cid, int is3DS) {
 	if (tables_generated == 0) {
 		aes_gen_tables();
@@ -148,8 +174,8 @@ void dsi_crypt_init(const uint8_t *console_id_be, const uint8_t *emmc_cid, int i
 	GET_UINT32_BE(console_id[0], console_id_be, 4);
 	GET_UINT32_BE(console_id[1], console_id_be, 0);
 
-	dsi_aes_set_key(nand_rk, console_id, is3DS ? NAND_3DS : NAND);
-	dsi_aes_set_key(es_rk, console_id, ES);
+	dsi_aes_set_key(nand_rk, nand_key, console_id, is3DS ? NAND_3DS : NAND);
+	dsi_aes_set_key(es_rk, NULL, console_id, ES);
 
 	aes_set_key_enc_128_be(boot2_rk, (uint8_t*)DSi_BOOT2_KEY);
 
@@ -159,6 +185,8 @@ void dsi_crypt_init(const uint8_t *console_id_be, const uint8_t *emmc_cid, int i
 	nand_ctr_iv[1] = digest[1];
 	nand_ctr_iv[2] = digest[2];
 	nand_ctr_iv[3] = digest[3];
+
+	dsi_nand_hw_probe();
 }
 
 static inline void aes_ctr(const uint32_t *rk, const uint32_t *ctr, uint32_t *in, uint32_t *out) {
@@ -177,15 +205,77 @@ void dsi_nand_crypt_1(uint8_t* out, const uint8_t* in, uint32_t offset) {
 	aes_ctr(nand_rk, ctr, (uint32_t*)in, (uint32_t*)out);
 }
 
-void dsi_nand_crypt(uint8_t* out, const uint8_t* in, uint32_t offset, unsigned count) {
+// buf must be in main RAM, the ARM7 can't see the DTCM
+static int dsi_aes_ctr_hw(uint32_t *buf, const uint32_t *ctr, unsigned count, int keyslot) {
+	aes_ctr_msg_t msg;
+	msg.buffer = buf;
+	msg.blocks = count;
+	msg.ctr[0] = ctr[0];
+	msg.ctr[1] = ctr[1];
+	msg.ctr[2] = ctr[2];
+	msg.ctr[3] = ctr[3];
+	msg.key[0] = nand_key[0];
+	msg.key[1] = nand_key[1];
+	msg.key[2] = nand_key[2];
+	msg.key[3] = nand_key[3];
+	msg.keyslot = keyslot;
+
+	DC_FlushRange(buf, count * AES_BLOCK_SIZE);
+
+	fifoSendDatamsg(FIFO_USER_08, sizeof(msg), (u8*)&msg);
+	fifoWaitValue32(FIFO_USER_08);
+
+	return fifoGetValue32(FIFO_USER_08) == 0;
+}
+
+// Only trust the engine once it gives the same result as the software path,
+// first with the console's own NAND keyslot, then with our normal key
+static void dsi_nand_hw_probe(void) {
+	static uint32_t test[8] __attribute__((aligned(32)));
+	static uint32_t expect[8] __attribute__((aligned(32)));
+	static const int keyslots[] = {AES_KEYSLOT_NAND, AES_KEYSLOT_FREE};
+
+	nand_hw_keyslot = -1;
+	for (unsigned i = 0; i < sizeof(keyslots) / sizeof(keyslots[0]); ++i) {
+		for (unsigned j = 0; j < 8; ++j)
+			test[j] = 0x9E3779B9u * (j + 1);
+		dsi_nand_crypt((uint8_t*)expect, (uint8_t*)test, 0xFFFFFFFFu, 2);
+
+		uint32_t ctr[4] = { nand_ctr_iv[0], nand_ctr_iv[1], nand_ctr_iv[2], nand_ctr_iv[3] };
+		add_128_32(ctr, 0xFFFFFFFFu);
+		if (dsi_aes_ctr_hw(test, ctr, 2, keyslots[i]) && memcmp(test, expect, sizeof(test)) == 0) {
+			nand_hw_keyslot = keyslots[i];
+			return;
+		}
+	}
+}
+
+int dsi_nand_crypt_hw(uint8_t* buf, uint32_t offset, unsigned count) {
+	if (nand_hw_keyslot < 0)
+		return 0;
+
 	uint32_t ctr[4] = { nand_ctr_iv[0], nand_ctr_iv[1], nand_ctr_iv[2], nand_ctr_iv[3] };
 	add_128_32(ctr, offset);
-	for (unsigned i = 0; i < count; ++i) {
-		aes_ctr(nand_rk, ctr, (uint32_t*)in, (uint32_t*)out);
-		out += AES_BLOCK_SIZE;
-		in += AES_BLOCK_SIZE;
-		add_128_32(ctr, 1);
+	while (count > 0) {
+		unsigned blocks = count < AES_HW_MAX_BLOCKS ? count : AES_HW_MAX_BLOCKS;
+		if (!dsi_aes_ctr_hw((uint32_t*)buf, ctr, blocks, nand_hw_keyslot)) {
+			// Fall back to software for good, buf may be partly crypted by
+			// now so the caller has to start over from the original data
+			nand_hw_keyslot = -1;
+			return -1;
+		}
+		buf += blocks * AES_BLOCK_SIZE;
+		count -= blocks;
+		add_128_32(ctr, blocks);
 	}
+
+	return 1;
+}
+
+void dsi_nand_crypt(uint8_t* out, const uint8_t* in, uint32_t offset, unsigned count) {
+	uint32_t ctr[4] = { nand_ctr_iv[0], nand_ctr_iv[1], nand_ctr_iv[2], nand_ctr_iv[3] };
+	add_128_32(ctr, offset);
+	aes_ctr_crypt_128_be(nand_rk, ctr, (const uint32_t*)in, (uint32_t*)out, count);
 }
 	
 static uint32_t boot2_ctr[4];
@@ -198,12 +288,7 @@ void dsi_boot2_crypt_set_ctr(uint32_t size_r) {
 }
 
 void dsi_boot2_crypt(uint8_t* out, const uint8_t* in, unsigned count) {
-	for (unsigned i = 0; i < count; ++i) {
-		aes_ctr(boot2_rk, boot2_ctr, (uint32_t*)in, (uint32_t*)out);
-		out += AES_BLOCK_SIZE;
-		in += AES_BLOCK_SIZE;
-		add_128_32(boot2_ctr, 1);
-	}
+	aes_ctr_crypt_128_be(boot2_rk, boot2_ctr, (const uint32_t*)in, (uint32_t*)out, count);
 }
 
 // http://problemkaputt.de/gbatek.htm#dsiesblockencryption
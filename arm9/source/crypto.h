@@ -25,6 +25,12 @@ void dsi_nand_crypt_1(uint8_t *out, const uint8_t* in, u32 offset);
 
 void dsi_nand_crypt(uint8_t *out, const uint8_t* in, u32 offset, unsigned count);
 
+// Crypts in place on the ARM7's AES engine, buf must be 32 byte aligned in
+// main RAM. Returns 0 if the hardware isn't usable, use dsi_nand_crypt then.
+// Returns -1 if it failed part way, buf is garbage and has to be refilled
+// before falling back to dsi_nand_crypt.
+int dsi_nand_crypt_hw(uint8_t *buf, u32 offset, unsigned count);
+
 int dsi_es_block_crypt(uint8_t *buf, unsigned buf_len, crypt_mode_t mode);
 
 void dsi_boot2_crypt_set_ctr(uint32_t size_r);
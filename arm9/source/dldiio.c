@@ -0,0 +1,119 @@
+#include "dldiio.h"
+#include "tonccpy.h"
+
+#include <malloc.h>
+
+#define SECTOR_SIZE 512
+
+static const DISC_INTERFACE *dldiDriver = NULL;
+static DISC_INTERFACE io_dldi_aligned;
+
+// Cache line aligned so drivers that DMA and invalidate around the
+// buffer don't touch anything else
+static u8 *bounceBuf = NULL;
+static u32 bounceSectors = 0;
+
+static u32 alignedRequests = 0;
+static u32 bouncedRequests = 0;
+
+static bool dldiio_startup(void) {
+	if (!dldiDriver->startup())
+		return false;
+
+	// Halve the buffer until it fits. If even one sector won't, unaligned
+	// requests just go to the driver as before
+	if (!bounceBuf) {
+		for (bounceSectors = DLDI_BOUNCE_SECTORS; bounceSectors > 0; bounceSectors /= 2) {
+			bounceBuf = (u8 *)memalign(32, bounceSectors * SECTOR_SIZE);
+			if (bounceBuf)
+				break;
+		}
+	}
+
+	return true;
+}
+
+static bool dldiio_is_inserted(void) {
+	return dldiDriver->isInserted();
+}
+
+static bool dldiio_read_sectors(sec_t sector, sec_t numSectors, void *buffer) {
+	if (((u32)buffer & 3) == 0 || !bounceBuf) {
+		alignedRequests++;
+		return dldiDriver->readSectors(sector, numSectors, buffer);
+	}
+
+	bouncedRequests++;
+	u8 *dst = (u8 *)buffer;
+	while (numSectors > 0) {
+		sec_t count = numSectors < bounceSectors ? numSectors : bounceSectors;
+		if (!dldiDriver->readSectors(sector, count, bounceBuf))
+			return false;
+
+		tonccpy(dst, bounceBuf, count * SECTOR_SIZE);
+		sector += count;
+		dst += count * SECTOR_SIZE;
+		numSectors -= count;
+	}
+
+	return true;
+}
+
+static bool dldiio_write_sectors(sec_t sector, sec_t numSectors, const void *buffer) {
+	if (((u32)buffer & 3) == 0 || !bounceBuf) {
+		alignedRequests++;
+		return dldiDriver->writeSectors(sector, numSectors, buffer);
+	}
+
+	bouncedRequests++;
+	const u8 *src = (const u8 *)buffer;
+	while (numSectors > 0) {
+		sec_t count = numSectors < bounceSectors ? numSectors : bounceSectors;
+		tonccpy(bounceBuf, src, count * SECTOR_SIZE);
+		if (!dldiDriver->writeSectors(sector, count, bounceBuf))
+			return false;
+
+		sector += count;
+		src += count * SECTOR_SIZE;
+		numSectors -= count;
+	}
+
+	return true;
+}
+
+static bool dldiio_clear_status(void) {
+	return dldiDriver->clearStatus();
+}
+
+static bool dldiio_shutdown(void) {
+	bool success = dldiDriver->shutdown();
+
+	free(bounceBuf);
+	bounceBuf = NULL;
+	bounceSectors = 0;
+	return success;
+}
+
+const DISC_INTERFACE *dldiio_wrap(const DISC_INTERFACE *driver) {
+	if (driver != dldiDriver) {
+		alignedRequests = 0;
+		bouncedRequests = 0;
+	}
+
+	dldiDriver = driver;
+	io_dldi_aligned.ioType = driver->ioType;
+	io_dldi_aligned.features = driver->features;
+	io_dldi_aligned.startup = dldiio_startup;
+	io_dldi_aligned.isInserted = dldiio_is_inserted;
+	io_dldi_aligned.readSectors = dldiio_read_sectors;
+	io_dldi_aligned.writeSectors = dldiio_write_sectors;
+	io_dldi_aligned.clearStatus = dldiio_clear_status;
+	io_dldi_aligned.shutdown = dldiio_shutdown;
+
+	return &io_dldi_aligned;
+}
+
+void dldiio_stats(u32 *aligned, u32 *bounced) {
+	*aligned = alignedRequests;
+	*bounced = bouncedRequests;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <nds.h>
+#include <nds/disc_io.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Largest bounce buffer tried, in 512 byte sectors
+#define DLDI_BOUNCE_SECTORS 32
+
+// Wraps a DLDI driver so unaligned buffers are read and written through an
+// aligned buffer instead of the driver's own byte by byte path
+const DISC_INTERFACE *dldiio_wrap(const DISC_INTERFACE *driver);
+
+// Requests passed straight to the driver and ones that had to be realigned,
+// since the driver was last wrapped
+void dldiio_stats(u32 *aligned, u32 *bounced);
+
+#ifdef __cplusplus
+}
+#endif
@@ -26,17 +26,22 @@
 #include <string.h>
 #include <stdio.h>
 #include <dirent.h>
+#include <sys/stat.h>
 
 #include "main.h"
 #include "config.h"
 #include "date.h"
 #include "screenshot.h"
+#include "dldiio.h"
 #include "dumpOperations.h"
 #include "driveOperations.h"
 #include "fileOperations.h"
 #include "font.h"
+#include "iostats.h"
 #include "language.h"
 #include "my_sd.h"
+#include "nandio.h"
+#include "ramd.h"
 #include "read_card.h"
 #include "startMenu.h"
 
@@ -161,6 +166,12 @@ void dm_drawBottomScreen(void) {
 
 	if(dmOperations[dmCursorPosition] == DriveMenuOperation::nitroFs || dmOperations[dmCursorPosition] == DriveMenuOperation::fatImage)
 		font->print(firstCol, row--, false, STR_IMAGETEXT, alignStart);
+	else if(dmOperations[dmCursorPosition] == DriveMenuOperation::ndsCard && romTitle[0][0] != 0)
+		font->print(firstCol, row--, false, STR_CARD_NITROFS_TEXT, alignStart);
+	else if(dmOperations[dmCursorPosition] == DriveMenuOperation::ramDrive && (sdMounted || flashcardMounted))
+		font->print(firstCol, row--, false, STR_RAMDRIVE_SNAPSHOT_TEXT, alignStart);
+	else if(dmOperations[dmCursorPosition] == DriveMenuOperation::sysNand && !is3DS && ((sdMounted && driveWritable(Drive::sdCard)) || (flashcardMounted && driveWritable(Drive::flashcard))))
+		font->print(firstCol, row--, false, STR_NAND_BACKUP_TEXT, alignStart);
 	font->print(firstCol, row--, false, titleName, alignStart);
 
 	switch(dmOperations[dmCursorPosition]) {
@@ -173,6 +184,12 @@ void dm_drawBottomScreen(void) {
 			font->printf(firstCol, 0, false, alignStart, Palette::white, STR_FLASHCARD_LABEL.c_str(), fatLabel[0] == 0 ? STR_UNTITLED.c_str() : fatLabel);
 			font->printf(firstCol, 1, false, alignStart, Palette::white, STR_SLOT1_FAT.c_str(), getBytes(fatSize).c_str());
 			font->printf(firstCol, 2, false, alignStart, Palette::white, STR_N_FREE.c_str(), getBytes(driveSizeFree(Drive::flashcard)).c_str());
+			{
+				u32 aligned, bounced;
+				dldiio_stats(&aligned, &bounced);
+				if(bounced > 0)
+					font->printf(firstCol, 3, false, alignStart, Palette::white, STR_DLDI_REALIGNED.c_str(), bounced, aligned + bounced);
+			}
 			break;
 		case DriveMenuOperation::gbaCart:
 			font->printf(firstCol, 0, false, alignStart, Palette::white, STR_GBA_GAMECART.c_str(), romTitle[1]);
@@ -194,11 +211,22 @@ void dm_drawBottomScreen(void) {
 			font->print(firstCol, 0, false, STR_RAMDRIVE_LABEL, alignStart);
 			font->printf(firstCol, 1, false, alignStart, Palette::white, STR_RAMDRIVE_FAT.c_str(), getBytes(ramdSize).c_str());
 			font->printf(firstCol, 2, false, alignStart, Palette::white, STR_N_FREE.c_str(), getBytes(driveSizeFree(Drive::ramDrive)).c_str());
+			if(ramdCompressed) {
+				u64 stored, physical, pool;
+				ramd_compression_stats(&stored, &physical, &pool);
+				font->printf(firstCol, 3, false, alignStart, Palette::white, STR_RAMDRIVE_COMPRESSED.c_str(), getBytes(stored).c_str(), getBytes(physical).c_str(), getBytes(pool).c_str());
+			}
 			break;
 		case DriveMenuOperation::sysNand:
 			font->print(firstCol, 0, false, STR_SYSNAND_LABEL, alignStart);
 			font->printf(firstCol, 1, false, alignStart, Palette::white, STR_SYSNAND_FAT.c_str(), getBytes(nandSize).c_str());
 			font->printf(firstCol, 2, false, alignStart, Palette::white, STR_N_FREE.c_str(), getBytes(driveSizeFree(Drive::nand)).c_str());
+			{
+				u32 hits, misses;
+				nandio_cache_stats(&hits, &misses);
+				if(hits + misses > 0)
+					font->printf(firstCol, 3, false, alignStart, Palette::white, STR_NAND_CACHE_HITS.c_str(), (u32)((u64)hits * 100 / (hits + misses)), hits + misses);
+			}
 			break;
 		case DriveMenuOperation::sysNandPhoto:
 			font->print(firstCol, 0, false, STR_SYSNAND_LABEL, alignStart);
@@ -217,6 +245,31 @@ void dm_drawBottomScreen(void) {
 	font->update(false);
 }
 
+void dm_saveRamdriveSnapshot(void) {
+	const char *path = ramdriveSnapshotPath();
+
+	font->clear(false);
+	font->print(firstCol, 0, false, STR_SAVING_RAMDRIVE, alignStart);
+	font->update(false);
+
+	char folderPath[10];
+	sprintf(folderPath, "%s:/gm9i", (sdMounted ? "sd" : "fat"));
+	if (access(folderPath, F_OK) != 0)
+		mkdir(folderPath, 0777);
+
+	font->clear(false);
+	if (ramdriveSnapshot(path))
+		font->printf(firstCol, 0, false, alignStart, Palette::white, (STR_RAMDRIVE_SAVED_TO + "\n\n" + STR_A_OK).c_str(), path);
+	else
+		font->print(firstCol, 0, false, STR_RAMDRIVE_SAVE_FAILED + "\n\n" + STR_A_OK, alignStart);
+	font->update(false);
+
+	do {
+		swiWaitForVBlank();
+		scanKeys();
+	} while (!(keysDown() & KEY_A));
+}
+
 void driveMenu (void) {
 	int pressed = 0;
 	int held = 0;
@@ -288,6 +341,8 @@ void driveMenu (void) {
 
 		stored_SCFG_MC = REG_SCFG_MC;
 
+		iostats_trace_flush();
+
 		// Power saving loop. Only poll the keys once per frame and sleep the CPU if there is nothing else to do
 		do {
 			scanKeys();
@@ -357,20 +412,33 @@ void driveMenu (void) {
 				|| (ramdriveMounted && nitroCurrentDrive == Drive::ramDrive)
 				|| (nandMounted && nitroCurrentDrive == Drive::nand)
 				|| (nandMounted && nitroCurrentDrive == Drive::nandPhoto)
-				|| (imgMounted && nitroCurrentDrive == Drive::fatImg))
+				|| (imgMounted && nitroCurrentDrive == Drive::fatImg)
+				|| (nitroCurrentDrive == Drive::ndsCard && !driveRemoved(Drive::ndsCard)))
 				{
 					currentDrive = Drive::nitroFS;
 					chdir("nitro:/");
 					screenMode = 1;
 					break;
 				}
+			} else if (dmOperations[dmCursorPosition] == DriveMenuOperation::ndsCard && (held & KEY_R) && romTitle[0][0] != 0) {
+				// Mount the card's NitroFS without dumping it
+				if (nitroCardMount()) {
+					currentDrive = Drive::nitroFS;
+					chdir("nitro:/");
+					screenMode = 1;
+					break;
+				}
 			} else if (dmOperations[dmCursorPosition] == DriveMenuOperation::ndsCard && (sdMounted || flashcardMounted || romTitle[1][0] != 0)) {
 				ndsCardDump();
+			} else if (dmOperations[dmCursorPosition] == DriveMenuOperation::ramDrive && (held & KEY_R) && ramdriveMounted && (sdMounted || flashcardMounted)) {
+				dm_saveRamdriveSnapshot();
 			} else if (dmOperations[dmCursorPosition] == DriveMenuOperation::ramDrive && ramdriveMounted) {
 				currentDrive = Drive::ramDrive;
 				chdir("ram:/");
 				screenMode = 1;
 				break;
+			} else if (dmOperations[dmCursorPosition] == DriveMenuOperation::sysNand && (held & KEY_R) && nandMounted && !is3DS && ((sdMounted && driveWritable(Drive::sdCard)) || (flashcardMounted && driveWritable(Drive::flashcard)))) {
+				nandBackup();
 			} else if (dmOperations[dmCursorPosition] == DriveMenuOperation::sysNand && nandMounted) {
 				currentDrive = Drive::nand;
 				chdir("nand:/");
@@ -3,18 +3,27 @@
 #include <nds.h>
 #include <nds/arm9/dldi.h>
 #include <dirent.h>
+#include <unistd.h>
 #include <fat.h>
+#include <limits.h>
 #include <stdio.h>
+#include <strings.h>
 #include <string>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
 
 #include "main.h"
 #include "dldi-include.h"
+#include "dldiio.h"
+#include "font.h"
+#include "iostats.h"
 #include "lzss.h"
 #include "ramd.h"
 #include "my_sd.h"
 #include "nandio.h"
+#include "nitrofs.h"
+#include "read_card.h"
+#include "config.h"
 #include "imgio.h"
 #include "tonccpy.h"
 #include "language.h"
@@ -69,6 +78,8 @@ const char* getDrivePath(void) {
 			return "nitro:/";
 		case Drive::fatImg:
 			return "img:/";
+		case Drive::ndsCard:
+			break;
 	}
 	return "";
 }
@@ -132,7 +143,7 @@ bool imgFound(void) {
 }
 
 bool nandMount(void) {
-	fatMountSimple("nand", &io_dsi_nand);
+	fatMountSimple("nand", iostats_wrap(IOSTATS_NAND, &io_dsi_nand));
 	if (nandFound()) {
 		struct statvfs st;
 		if (statvfs("nand:/", &st) == 0) {
@@ -165,7 +176,7 @@ void nandUnmount(void) {
 }
 
 bool sdMount(void) {
-	fatMountSimple("sd", __my_io_dsisd());
+	fatMountSimple("sd", iostats_wrap(IOSTATS_SD, __my_io_dsisd()));
 	if (sdFound()) {
 		sdMountedDone = true;
 		fatGetVolumeLabel("sd", sdLabel);
@@ -289,10 +300,10 @@ TWL_CODE bool twl_flashcardMount(void) {
 		// Read a DLDI driver specific to the cart
 		if (!memcmp(gamename, "QMATETRIAL", 9) || !memcmp(gamename, "R4DSULTRA", 9)) {
 			io_dldi_data = dldiLoadFromBin(r4idsn_sd_dldi);
-			fatMountSimple("fat", dldiGet());
+			fatMountSimple("fat", iostats_wrap(IOSTATS_FLASHCARD, dldiio_wrap(dldiGet())));
 		} else if (!memcmp(gameid, "ACEK", 4) || !memcmp(gameid, "YCEP", 4) || !memcmp(gameid, "AHZH", 4) || !memcmp(gameid, "CHPJ", 4) || !memcmp(gameid, "ADLP", 4)) {
 			io_dldi_data = dldiLoadFromBin(ak2_sd_dldi);
-			fatMountSimple("fat", dldiGet());
+			fatMountSimple("fat", iostats_wrap(IOSTATS_FLASHCARD, dldiio_wrap(dldiGet())));
 		}
 
 		if (flashcardFound()) {
@@ -308,9 +319,32 @@ TWL_CODE bool twl_flashcardMount(void) {
 	return false;
 }
 
+// What fatInitDefault() would have done, start in the folder we were
+// launched from if that's on the flashcard
+static void flashcardChdirDefault(void) {
+	char path[PATH_MAX] = "fat:/";
+	if (__system_argv->argvMagic == ARGV_MAGIC && __system_argv->argc >= 1 && strncasecmp(__system_argv->argv[0], "fat:", 4) == 0) {
+		strncpy(path, __system_argv->argv[0], sizeof(path) - 1);
+		path[sizeof(path) - 1] = '\0';
+		char *lastSlash = strrchr(path, '/');
+		if (lastSlash) {
+			if (*(lastSlash - 1) == ':')
+				lastSlash++;
+			*lastSlash = '\0';
+		} else {
+			strcpy(path, "fat:/");
+		}
+	}
+	chdir(path);
+}
+
 bool flashcardMount(void) {
 	if (!isDSiMode() || (arm7SCFGLocked && !sdMountedDone)) {
-		fatInitDefault();
+		if (isDSiMode()) {
+			fatInitDefault();
+		} else if (fatMountSimple("fat", iostats_wrap(IOSTATS_FLASHCARD, dldiio_wrap(dldiGet())))) {
+			flashcardChdirDefault();
+		}
 		if (flashcardFound()) {
 			fatGetVolumeLabel("fat", fatLabel);
 			fixLabel(fatLabel);
@@ -338,11 +372,15 @@ void flashcardUnmount(void) {
 	flashcardMounted = false;
 }
 
-void ramdriveMount(bool ram32MB) {
+static bool ramdrive32MB = false;
+
+void ramdriveMount(bool ram32MB, bool compressed) {
+	ramdrive32MB = ram32MB;
 	if(isDSiMode() || REG_SCFG_EXT != 0) {
 		ramdSectors = ram32MB ? 0xE000 : 0x6000;
+		ramdCompressed = compressed;
 
-		fatMountSimple("ram", &io_ram_drive);
+		fatMountSimple("ram", iostats_wrap(IOSTATS_RAMDRIVE, &io_ram_drive));
 	} else if (isRegularDS) {
 		ramdSectors = 0x8 + 0x4000;
 		ramdLocMep = (u8*)0x09000000;
@@ -390,7 +428,7 @@ void ramdriveMount(bool ram32MB) {
 		}
 
 		if (*(u16*)(0x020000C0) != 0 || *(vu16*)(0x08240000) == 1) {
-			fatMountSimple("ram", &io_ram_drive);
+			fatMountSimple("ram", iostats_wrap(IOSTATS_RAMDRIVE, &io_ram_drive));
 		}
 	}
 
@@ -415,6 +453,43 @@ void ramdriveUnmount(void) {
 	ramdriveMounted = false;
 }
 
+const char *ramdriveSnapshotPath(void) {
+	return sdMounted ? "sd:/gm9i/ramdrive.ramd" : "fat:/gm9i/ramdrive.ramd";
+}
+
+bool ramdriveSnapshot(const char *path) {
+	FILE *file = fopen(path, "wb");
+	if(!file)
+		return false;
+
+	bool success = ramd_snapshot_save(file);
+	fclose(file);
+	if(!success)
+		remove(path);
+	return success;
+}
+
+bool ramdriveRestore(const char *path) {
+	FILE *file = fopen(path, "rb");
+	if(!file)
+		return false;
+
+	if(!ramd_snapshot_fits(file)) {
+		fclose(file);
+		return false;
+	}
+
+	// libfat caches the FAT, so remount with the snapshot loaded at startup
+	// rather than writing it under a mounted drive
+	bool compressed = ramdCompressed;
+	ramdriveUnmount();
+	ramd_snapshot_restore(file);
+	ramdriveMount(ramdrive32MB, compressed);
+	fclose(file);
+
+	return ramdriveMounted && ramd_snapshot_restored();
+}
+
 void nitroUnmount(void) {
 	if(imgMounted && imgCurrentDrive == Drive::nitroFS)
 		imgUnmount();
@@ -423,11 +498,28 @@ void nitroUnmount(void) {
 	nitroMounted = false;
 }
 
-bool imgMount(const char* imgName, bool dsiwareSave) {
+bool nitroCardMount(void) {
+	if(nitroMounted)
+		nitroUnmount();
+
+	sNDSHeaderExt ndsHeader;
+	if(cardInit(&ndsHeader) != 0)
+		return false;
+
+	nitroMounted = nitroFSInitCard();
+	if(nitroMounted)
+		nitroCurrentDrive = Drive::ndsCard;
+
+	return nitroMounted;
+}
+
+bool imgMount(const char* imgName, bool dsiwareSave, bool writable) {
 	extern char currentImgName[PATH_MAX];
 
 	strcpy(currentImgName, imgName);
-	fatMountSimple("img", dsiwareSave ? &io_dsiware_save : &io_img);
+	img_set_cache_size(config->imgCacheSectors());
+	img_set_writable(writable);
+	fatMountSimple("img", iostats_wrap(IOSTATS_IMAGE, dsiwareSave ? &io_dsiware_save : &io_img));
 	if (imgFound()) {
 		fatGetVolumeLabel("img", imgLabel);
 		fixLabel(imgLabel);
@@ -440,15 +532,30 @@ bool imgMount(const char* imgName, bool dsiwareSave) {
 	return false;
 }
 
-void imgUnmount(void) {
+bool imgUnmount(void) {
 	if(nitroMounted && nitroCurrentDrive == Drive::fatImg)
 		nitroUnmount();
 
+	// Writes sit in imgio's cache until now, so this is where they can fail
 	fatUnmount("img");
-	img_shutdown();
+	bool success = img_shutdown();
 	imgLabel[0] = '\0';
 	imgSize = 0;
 	imgMounted = false;
+
+	if(!success) {
+		font->clear(false);
+		font->print(firstCol, 0, false, STR_IMG_WRITE_BACK_FAILED, alignStart, Palette::red);
+		font->print(firstCol, font->calcHeight(STR_IMG_WRITE_BACK_FAILED) + 1, false, STR_A_OK, alignStart);
+		font->update(false);
+
+		do {
+			swiWaitForVBlank();
+			scanKeys();
+		} while(!(keysDown() & KEY_A));
+	}
+
+	return success;
 }
 
 bool driveWritable(Drive drive) {
@@ -466,6 +573,8 @@ bool driveWritable(Drive drive) {
 			return false;
 		case Drive::fatImg:
 			return io_img.features & FEATURE_MEDIUM_CANWRITE;
+		case Drive::ndsCard:
+			return false;
 	}
 
 	return false;
@@ -487,6 +596,8 @@ bool driveRemoved(Drive drive) {
 			return driveRemoved(nitroCurrentDrive);
 		case Drive::fatImg:
 			return driveRemoved(imgCurrentDrive);
+		case Drive::ndsCard:
+			return isDSiMode() && (REG_SCFG_MC & BIT(0));
 	}
 
 	return false;
@@ -508,6 +619,8 @@ u64 driveSizeFree(Drive drive) {
 			return 0;
 		case Drive::fatImg:
 			return getBytesFree("img:/");
+		case Drive::ndsCard:
+			return 0;
 	}
 
 	return 0;
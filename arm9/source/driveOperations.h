@@ -11,7 +11,8 @@ enum class Drive : u8 {
 	nand,
 	nandPhoto,
 	nitroFS,
-	fatImg
+	fatImg,
+	ndsCard
 };
 
 extern bool nandMounted;
@@ -53,11 +54,15 @@ extern bool sdMount(void);
 extern void sdUnmount(void);
 extern bool flashcardMount(void);
 extern void flashcardUnmount(void);
-extern void ramdriveMount(bool ram32MB);
+extern void ramdriveMount(bool ram32MB, bool compressed = false);
 extern void ramdriveUnmount(void);
+extern const char *ramdriveSnapshotPath(void);
+extern bool ramdriveSnapshot(const char *path);
+extern bool ramdriveRestore(const char *path);
 extern void nitroUnmount(void);
-extern bool imgMount(const char* imgName, bool dsiwareSave);
-extern void imgUnmount(void);
+extern bool nitroCardMount(void);
+extern bool imgMount(const char* imgName, bool dsiwareSave, bool writable = false);
+extern bool imgUnmount(void);
 extern u64 getBytesFree(const char* drivePath);
 extern bool driveWritable(Drive drive);
 extern bool driveRemoved(Drive drive);
@@ -9,24 +9,24 @@
 #include "gba.h"
 #include "lzss.h"
 #include "main.h"
+#include "nandio.h"
 #include "ndsheaderbanner.h"
 #include "read_card.h"
 #include "tonccpy.h"
 #include "language.h"
 #include "screenshot.h"
+#include "sha1.h"
 #include "version.h"
 
+#include <algorithm>
 #include <dirent.h>
+#include <malloc.h>
 #include <nds.h>
 #include <nds/arm9/dldi.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <vector>
 
-#define copyBufSize 0x8000
-
-extern u8 copyBuf[copyBufSize];
-
 static sNDSHeaderExt ndsCardHeader;
 
 enum DumpOption {
@@ -1331,3 +1331,350 @@ void gbaCartDump(void) {
 	if(config->screenSwap())
 		screenSwapped ? lcdMainOnBottom() : lcdMainOnTop();
 }
+
+// Raw NAND backups, laid out like no$gba's so other tools can decrypt them
+#define NAND_CHUNK_SECTORS 256
+#define NAND_FOOTER_MAGIC "DSi eMMC CID/CPU"
+
+typedef struct {
+	char magic[16];
+	u8 cid[16];
+	u8 consoleId[8];
+	u8 reserved[0x18];
+} NocashFooter;
+
+static_assert(sizeof(NocashFooter) == 0x40, "no$gba footer must be 0x40 bytes");
+
+static void nandProgress(int row, u32 sector, u32 sectors) {
+	if(sector == 0) {
+		font->print(firstCol, row, false, STR_PROGRESS, alignStart);
+		font->print(0, row + 1, false, "[");
+		font->print(-1, row + 1, false, "]");
+	}
+
+	int progressPos = ((u64)sector * (SCREEN_COLS - 2) / sectors) + 1;
+	if(rtl)
+		progressPos = (progressPos + 1) * -1;
+	font->print(progressPos, row + 1, false, "=");
+	font->printf(firstCol, row + 2, false, alignStart, Palette::white, STR_N_OF_N_BYTES.c_str(), sector * 512, sectors * 512);
+	font->update(false);
+}
+
+static bool nandWriteSha1(const char *path, const u8 *digest) {
+	char sha1Path[256];
+	snprintf(sha1Path, sizeof(sha1Path), "%s.sha1", path);
+	FILE *file = fopen(sha1Path, "wb");
+	if(!file)
+		return false;
+
+	// Same layout as sha1sum so it can be checked on a PC too
+	for(int i = 0; i < 20; i++)
+		fprintf(file, "%02x", digest[i]);
+	fprintf(file, " *%s\n", strrchr(path, '/') + 1);
+	return fclose(file) == 0;
+}
+
+// Returns false if there's no SHA1 file next to the backup
+static bool nandReadSha1(const char *path, u8 *digest) {
+	char sha1Path[256];
+	snprintf(sha1Path, sizeof(sha1Path), "%s.sha1", path);
+	FILE *file = fopen(sha1Path, "rb");
+	if(!file)
+		return false;
+
+	bool valid = true;
+	for(int i = 0; i < 20 && valid; i++) {
+		unsigned int byte;
+		valid = fscanf(file, "%2x", &byte) == 1;
+		digest[i] = byte;
+	}
+	fclose(file);
+	return valid;
+}
+
+void nandBackup(void) {
+	u32 sectors = nandio_get_size();
+	Drive destDrive = sdMounted ? Drive::sdCard : Drive::flashcard;
+	const char *destName = sdMounted ? "sd" : "fat";
+
+	font->clear(false);
+	font->printf(firstCol, 0, false, alignStart, Palette::white, (STR_BACKUP_NAND_TO + "\n\n" + STR_A_YES_B_NO).c_str(), getBytes((u64)sectors * 512).c_str(), destName);
+	font->update(false);
+
+	u16 pressed;
+	do {
+		scanKeys();
+		pressed = keysDownRepeat();
+		swiWaitForVBlank();
+	} while (!(pressed & (KEY_A | KEY_B)));
+
+	if(pressed & KEY_B)
+		return;
+
+	if(sectors == 0) {
+		dumpFailMsg(STR_NAND_BACKUP_FAILED);
+		return;
+	}
+
+	if(driveSizeFree(destDrive) < (u64)sectors * 512 + sizeof(NocashFooter)) {
+		dumpFailMsg(STR_NAND_BACKUP_NO_SPACE);
+		return;
+	}
+
+	char folderPath[2][16];
+	sprintf(folderPath[0], "%s:/gm9i", destName);
+	sprintf(folderPath[1], "%s:/gm9i/out", destName);
+	for(const char *folder : folderPath) {
+		if (access(folder, F_OK) != 0)
+			mkdir(folder, 0777);
+	}
+
+	char destPath[64];
+	snprintf(destPath, sizeof(destPath), "%s:/gm9i/out/nand_%s.bin", destName, RetTime("%Y%m%d_%H%M%S").c_str());
+
+	u8 *buffer = (u8 *)memalign(32, NAND_CHUNK_SECTORS * 512);
+	FILE *destinationFile = buffer ? fopen(destPath, "wb") : nullptr;
+	if(!destinationFile) {
+		free(buffer);
+		dumpFailMsg(STR_NAND_BACKUP_FAILED);
+		return;
+	}
+
+	font->clear(false);
+	font->print(firstCol, 0, false, STR_BACKING_UP_NAND, alignStart);
+	font->update(false);
+
+	// The SHA1 is worked out as the image is written, rather than reading
+	// 240MB back again afterwards
+	SHA1_CTX sha1;
+	SHA1Init(&sha1);
+
+	bool success = true;
+	for(u32 sector = 0; sector < sectors && success; sector += NAND_CHUNK_SECTORS) {
+		u32 count = std::min<u32>(NAND_CHUNK_SECTORS, sectors - sector);
+		nandProgress(2, sector, sectors);
+
+		success = nandio_read_raw_sectors(sector, count, buffer)
+			&& fwrite(buffer, 512, count, destinationFile) == count;
+		SHA1Update(&sha1, buffer, count * 512);
+	}
+
+	NocashFooter footer;
+	toncset(&footer, 0, sizeof(footer));
+	tonccpy(footer.magic, NAND_FOOTER_MAGIC, sizeof(footer.magic));
+	nandio_get_ids(footer.cid, footer.consoleId);
+	if(success) {
+		success = fwrite(&footer, sizeof(footer), 1, destinationFile) == 1;
+		SHA1Update(&sha1, (u8 *)&footer, sizeof(footer));
+	}
+
+	success &= fclose(destinationFile) == 0;
+	free(buffer);
+
+	u8 digest[20];
+	SHA1Final(digest, &sha1);
+	if(!success || !nandWriteSha1(destPath, digest)) {
+		remove(destPath);
+		dumpFailMsg(STR_NAND_BACKUP_FAILED);
+		return;
+	}
+
+	font->clear(false);
+	font->printf(firstCol, 0, false, alignStart, Palette::white, (STR_NAND_BACKUP_SAVED_TO + "\n\n" + STR_A_OK).c_str(), destPath);
+	font->update(false);
+
+	do {
+		swiWaitForVBlank();
+		scanKeys();
+	} while (!(keysDown() & KEY_A));
+}
+
+bool nandBackupSizeMatches(off_t size) {
+	u64 imageSize = (u64)nandio_get_size() * 512;
+	return imageSize > 0 && ((u64)size == imageSize || (u64)size == imageSize + sizeof(NocashFooter));
+}
+
+void nandRestore(const char *filename) {
+	u32 sectors = nandio_get_size();
+
+	FILE *sourceFile = fopen(filename, "rb");
+	if(!sourceFile) {
+		dumpFailMsg(STR_NAND_RESTORE_FAILED);
+		return;
+	}
+
+	fseek(sourceFile, 0, SEEK_END);
+	u64 length = ftell(sourceFile);
+	fseek(sourceFile, 0, SEEK_SET);
+
+	u8 *fileBuffer = (u8 *)memalign(32, NAND_CHUNK_SECTORS * 512);
+	u8 *nandBuffer = (u8 *)memalign(32, NAND_CHUNK_SECTORS * 512);
+	if(!fileBuffer || !nandBuffer || !nandBackupSizeMatches(length)) {
+		free(fileBuffer);
+		free(nandBuffer);
+		fclose(sourceFile);
+		dumpFailMsg(STR_NAND_RESTORE_FAILED);
+		return;
+	}
+
+	// Writing another console's NAND would brick this one, so check both
+	// the footer if there is one and that the image decrypts
+	bool sameConsole = fread(fileBuffer, 512, 1, sourceFile) == 1 && nandio_raw_image_matches(fileBuffer);
+	if(sameConsole && length > (u64)sectors * 512) {
+		NocashFooter footer, current;
+		nandio_get_ids(current.cid, current.consoleId);
+		fseek(sourceFile, (u64)sectors * 512, SEEK_SET);
+		if(fread(&footer, sizeof(footer), 1, sourceFile) == 1 && memcmp(footer.magic, NAND_FOOTER_MAGIC, sizeof(footer.magic)) == 0) {
+			sameConsole = memcmp(footer.cid, current.cid, sizeof(footer.cid)) == 0
+				&& memcmp(footer.consoleId, current.consoleId, sizeof(footer.consoleId)) == 0;
+		}
+	}
+
+	if(!sameConsole) {
+		free(fileBuffer);
+		free(nandBuffer);
+		fclose(sourceFile);
+		dumpFailMsg(STR_NAND_BACKUP_OTHER_CONSOLE);
+		return;
+	}
+
+	font->clear(false);
+	font->print(firstCol, 0, false, STR_RESTORE_NAND_CONFIRM + "\n\n" + STR_A_YES_B_NO, alignStart);
+	font->update(false);
+
+	u16 pressed;
+	do {
+		scanKeys();
+		pressed = keysDownRepeat();
+		swiWaitForVBlank();
+	} while (!(pressed & (KEY_A | KEY_B)));
+
+	if(pressed & KEY_B) {
+		free(fileBuffer);
+		free(nandBuffer);
+		fclose(sourceFile);
+		return;
+	}
+
+	// First pass only reads, noting which chunks differ and checking the
+	// backup against its SHA1 before anything gets written
+	font->clear(false);
+	font->print(firstCol, 0, false, STR_COMPARING_NAND, alignStart);
+	font->update(false);
+
+	u32 chunks = (sectors + NAND_CHUNK_SECTORS - 1) / NAND_CHUNK_SECTORS;
+	std::vector<bool> changed(chunks, false);
+	u32 changedChunks = 0;
+	SHA1_CTX sha1;
+	SHA1Init(&sha1);
+
+	fseek(sourceFile, 0, SEEK_SET);
+	bool success = true;
+	for(u32 chunk = 0; chunk < chunks && success; chunk++) {
+		u32 sector = chunk * NAND_CHUNK_SECTORS;
+		u32 count = std::min<u32>(NAND_CHUNK_SECTORS, sectors - sector);
+		nandProgress(2, sector, sectors);
+
+		success = fread(fileBuffer, 512, count, sourceFile) == count
+			&& nandio_read_raw_sectors(sector, count, nandBuffer);
+		SHA1Update(&sha1, fileBuffer, count * 512);
+		if(success && memcmp(fileBuffer, nandBuffer, count * 512) != 0) {
+			changed[chunk] = true;
+			changedChunks++;
+		}
+	}
+
+	if(success && length > (u64)sectors * 512) {
+		NocashFooter footer;
+		success = fread(&footer, sizeof(footer), 1, sourceFile) == 1;
+		SHA1Update(&sha1, (u8 *)&footer, sizeof(footer));
+	}
+
+	u8 digest[20], expected[20];
+	SHA1Final(digest, &sha1);
+	if(success && nandReadSha1(filename, expected) && memcmp(digest, expected, 20) != 0) {
+		free(fileBuffer);
+		free(nandBuffer);
+		fclose(sourceFile);
+		dumpFailMsg(STR_NAND_BACKUP_CORRUPT);
+		return;
+	}
+
+	if(success && changedChunks == 0) {
+		free(fileBuffer);
+		free(nandBuffer);
+		fclose(sourceFile);
+
+		font->clear(false);
+		font->print(firstCol, 0, false, STR_NAND_ALREADY_MATCHES + "\n\n" + STR_A_OK, alignStart);
+		font->update(false);
+
+		do {
+			swiWaitForVBlank();
+			scanKeys();
+		} while (!(keysDown() & KEY_A));
+		return;
+	}
+
+	// Nothing libfat has cached about nand: holds after this
+	if(success)
+		nandUnmount();
+
+	font->clear(false);
+	font->print(firstCol, 0, false, STR_RESTORING_NAND, alignStart);
+	font->print(firstCol, 1, false, STR_DO_NOT_TURN_OFF_POWER, alignStart);
+	font->update(false);
+
+	// Second pass writes only the sectors that differ, reading each run back
+	u32 written = 0;
+	for(u32 chunk = 0; chunk < chunks && success; chunk++) {
+		if(!changed[chunk])
+			continue;
+
+		u32 sector = chunk * NAND_CHUNK_SECTORS;
+		u32 count = std::min<u32>(NAND_CHUNK_SECTORS, sectors - sector);
+		nandProgress(3, sector, sectors);
+
+		success = fseek(sourceFile, (u64)sector * 512, SEEK_SET) == 0
+			&& fread(fileBuffer, 512, count, sourceFile) == count
+			&& nandio_read_raw_sectors(sector, count, nandBuffer);
+
+		for(u32 i = 0; i < count && success;) {
+			if(memcmp(fileBuffer + i * 512, nandBuffer + i * 512, 512) == 0) {
+				i++;
+				continue;
+			}
+
+			u32 run = 1;
+			while(i + run < count && memcmp(fileBuffer + (i + run) * 512, nandBuffer + (i + run) * 512, 512) != 0)
+				run++;
+
+			success = nandio_write_raw_sectors(sector + i, run, fileBuffer + i * 512)
+				&& nandio_read_raw_sectors(sector + i, run, nandBuffer + i * 512)
+				&& memcmp(fileBuffer + i * 512, nandBuffer + i * 512, run * 512) == 0;
+			written += run;
+			i += run;
+		}
+	}
+
+	free(fileBuffer);
+	free(nandBuffer);
+	fclose(sourceFile);
+
+	if(!nandMounted)
+		nandMount();
+
+	if(!success) {
+		dumpFailMsg(STR_NAND_RESTORE_FAILED);
+		return;
+	}
+
+	font->clear(false);
+	font->printf(firstCol, 0, false, alignStart, Palette::white, (STR_NAND_RESTORED + "\n\n" + STR_A_OK).c_str(), written);
+	font->update(false);
+
+	do {
+		swiWaitForVBlank();
+		scanKeys();
+	} while (!(keysDown() & KEY_A));
+}
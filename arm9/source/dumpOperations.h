@@ -1,10 +1,16 @@
 #ifndef DUMPING_H
 #define DUMPING_H
 
+#include <sys/types.h>
+
 void ndsCardSaveRestore(const char *filename);
 void gbaCartSaveRestore(const char *filename);
 
 void ndsCardDump(void);
 void gbaCartDump(void);
 
+void nandBackup(void);
+bool nandBackupSizeMatches(off_t size);
+void nandRestore(const char *filename);
+
 #endif //DUMPING_H
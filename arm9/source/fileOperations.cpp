@@ -9,10 +9,10 @@
 #include "file_browse.h"
 #include "font.h"
 #include "ndsheaderbanner.h"
+#include "nitrofs.h"
 #include "screenshot.h"
 #include "language.h"
 
-#define copyBufSize 0x8000
 #define shaChunkSize 0x10000
 
 // u8* copyBuf = (u8*)0x02004000;
@@ -337,6 +337,59 @@ bool fcopy(const char *sourcePath, const char *destinationPath) {
 	}
 }
 
+static const char *nitroExtractSource;
+static const char *nitroExtractDest;
+static int nitroExtractProgressPos;
+
+static bool nitroExtractProgress(u32 done, u32 total, const char *path) {
+	if (path == nullptr) {
+		// Check that everything will fit before anything is written
+		if (total > driveSizeFree(getDriveFromPath(nitroExtractDest))) {
+			font->clear(false);
+			font->printf(0, 0, false, Alignment::left, Palette::white, (STR_FILE_TOO_BIG + "\n\n" + STR_A_OK).c_str(), nitroExtractSource);
+			font->update(false);
+
+			do {
+				swiWaitForVBlank();
+				scanKeys();
+			} while(!(keysDown() & KEY_A));
+
+			return false;
+		}
+
+		font->clear(false);
+		font->print(firstCol, 0, false, STR_PROGRESS, alignStart);
+		font->print(0, 1, false, "[");
+		font->print(-1, 1, false, "]");
+		font->update(false);
+		nitroExtractProgressPos = 0;
+		return true;
+	}
+
+	scanKeys();
+	if (keysHeld() & KEY_B)
+		return false;
+
+	// Only redraw when the bar moves, there can be thousands of small files
+	int progressPos = total ? ((u64)done * (SCREEN_COLS - 2) / total) + 1 : 1;
+	if (progressPos != nitroExtractProgressPos || done == total) {
+		for (int i = nitroExtractProgressPos + 1; i <= progressPos; i++)
+			font->print(rtl ? (i + 1) * -1 : i, 1, false, "=");
+		nitroExtractProgressPos = progressPos;
+		font->printf(firstCol, 2, false, alignStart, Palette::white, "%-*s", SCREEN_COLS, "");
+		font->printf(firstCol, 2, false, alignStart, Palette::white, STR_N_OF_N_BYTES.c_str(), (int)done, (int)total);
+		font->update(false);
+	}
+
+	return true;
+}
+
+bool nitroExtract(const char *sourcePath, const char *destinationPath) {
+	nitroExtractSource = sourcePath;
+	nitroExtractDest = destinationPath;
+	return nitroFSExtract(sourcePath, destinationPath, nitroExtractProgress) == 0;
+}
+
 void changeFileAttribs(const DirEntry *entry) {
 	int pressed = 0, held = 0;
 	int cursorScreenPos = font->calcHeight(entry->name);
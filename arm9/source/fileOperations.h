@@ -6,6 +6,10 @@
 #ifndef FILE_COPY
 #define FILE_COPY
 
+#define copyBufSize 0x8000
+
+extern u8 copyBuf[copyBufSize];
+
 struct ClipboardFile {
 	std::string path;
 	std::string name;
@@ -25,6 +29,7 @@ extern off_t getFileSize(const char *fileName);
 extern bool calculateSHA1(const char *fileName, u8 *sha1);
 extern int trimNds(const char *fileName);
 extern bool fcopy(const char *sourcePath, const char *destinationPath);
+extern bool nitroExtract(const char *sourcePath, const char *destinationPath);
 void changeFileAttribs(const DirEntry *entry);
 
 #endif // FILE_COPY
@@ -42,6 +42,7 @@
 #include "dumpOperations.h"
 #include "font.h"
 #include "hexEditor.h"
+#include "iostats.h"
 #include "my_sd.h"
 #include "keyboard.h"
 #include "ndsInfo.h"
@@ -198,10 +199,23 @@ FileOperation fileBrowse_A(DirEntry* entry, const char *curdir) {
 		}
 		if(currentDrive != Drive::fatImg && extension(entry->name, {"img", "sd", "sav", "pub", "pu1", "pu2", "pu3", "pu4", "pu5", "pu6", "pu7", "pu8", "pu9", "prv", "pr1", "pr2", "pr3", "pr4", "pr5", "pr6", "pr7", "pr8", "pr9", "0000"})) {
 			operations.push_back(FileOperation::mountImg);
+			if(driveWritable(currentDrive))
+				operations.push_back(FileOperation::mountImgWritable);
 		}
 		if(extension(entry->name, {"frf"})) {
 			operations.push_back(FileOperation::loadFont);
 		}
+		if(ramdriveMounted && extension(entry->name, {"ramd"}) && currentDrive != Drive::ramDrive
+		 && !(currentDrive == Drive::fatImg && imgCurrentDrive == Drive::ramDrive)
+		 && !(currentDrive == Drive::nitroFS && nitroCurrentDrive == Drive::ramDrive)) {
+			operations.push_back(FileOperation::restoreRamdrive);
+		}
+		if(nandMounted && !is3DS && extension(entry->name, {"bin"}) && (currentDrive == Drive::sdCard || currentDrive == Drive::flashcard)
+		 && !(imgMounted && (imgCurrentDrive == Drive::nand || imgCurrentDrive == Drive::nandPhoto))
+		 && !(nitroMounted && (nitroCurrentDrive == Drive::nand || nitroCurrentDrive == Drive::nandPhoto))
+		 && nandBackupSizeMatches(entry->size)) {
+			operations.push_back(FileOperation::restoreNand);
+		}
 
 		operations.push_back(FileOperation::hexEdit);
 		operations.push_back(FileOperation::calculateSHA1);
@@ -250,6 +264,9 @@ FileOperation fileBrowse_A(DirEntry* entry, const char *curdir) {
 				case FileOperation::mountImg:
 					font->print(optionsCol, row++, false, STR_MOUNT_FAT_IMG, alignStart);
 					break;
+				case FileOperation::mountImgWritable:
+					font->print(optionsCol, row++, false, STR_MOUNT_FAT_IMG_WRITABLE, alignStart);
+					break;
 				case FileOperation::hexEdit:
 					font->print(optionsCol, row++, false, STR_OPEN_HEX, alignStart);
 					break;
@@ -268,6 +285,12 @@ FileOperation fileBrowse_A(DirEntry* entry, const char *curdir) {
 				case FileOperation::loadFont:
 					font->print(optionsCol, row++, false, STR_LOAD_FONT, alignStart);
 					break;
+				case FileOperation::restoreRamdrive:
+					font->print(optionsCol, row++, false, STR_RESTORE_RAMDRIVE, alignStart);
+					break;
+				case FileOperation::restoreNand:
+					font->print(optionsCol, row++, false, STR_RESTORE_NAND, alignStart);
+					break;
 				case FileOperation::none:
 					row++;
 					break;
@@ -318,6 +341,9 @@ FileOperation fileBrowse_A(DirEntry* entry, const char *curdir) {
 				} case FileOperation::restoreSaveGba: {
 					gbaCartSaveRestore(entry->name.c_str());
 					break;
+				} case FileOperation::restoreNand: {
+					nandRestore(entry->name.c_str());
+					break;
 				} case FileOperation::copySdOut: {
 					if (access("sd:/gm9i", F_OK) != 0) {
 						font->print(optionsCol, optionOffset + y, false, STR_CREATING_DIRECTORY, alignStart);
@@ -336,7 +362,10 @@ FileOperation fileBrowse_A(DirEntry* entry, const char *curdir) {
 					remove(destPath);
 					char sourcePath[PATH_MAX];
 					snprintf(sourcePath, sizeof(sourcePath), "%s%s", curdir, entry->name.c_str());
-					fcopy(sourcePath, destPath);
+					if (currentDrive == Drive::nitroFS && entry->isDirectory)
+						nitroExtract(sourcePath, destPath); // Streams the ROM in offset order
+					else
+						fcopy(sourcePath, destPath);
 					chdir(curdir); // For after copying a folder
 					break;
 				} case FileOperation::copyFatOut: {
@@ -357,7 +386,10 @@ FileOperation fileBrowse_A(DirEntry* entry, const char *curdir) {
 					remove(destPath);
 					char sourcePath[PATH_MAX];
 					snprintf(sourcePath, sizeof(sourcePath), "%s%s", curdir, entry->name.c_str());
-					fcopy(sourcePath, destPath);
+					if (currentDrive == Drive::nitroFS && entry->isDirectory)
+						nitroExtract(sourcePath, destPath); // Streams the ROM in offset order
+					else
+						fcopy(sourcePath, destPath);
 					chdir(curdir);	// For after copying a folder
 					break;
 				} case FileOperation::mountNitroFS: {
@@ -381,11 +413,12 @@ FileOperation fileBrowse_A(DirEntry* entry, const char *curdir) {
 				} case FileOperation::showInfo: {
 					changeFileAttribs(entry);
 					break;
-				} case FileOperation::mountImg: {
+				} case FileOperation::mountImg:
+				  case FileOperation::mountImgWritable: {
 					if(imgMounted)
 						imgUnmount();
 
-					imgMounted = imgMount(entry->name.c_str(), !extension(entry->name, {"img", "sd"}));
+					imgMounted = imgMount(entry->name.c_str(), !extension(entry->name, {"img", "sd"}), operations[optionOffset] == FileOperation::mountImgWritable);
 					if (imgMounted) {
 						chdir("img:/");
 						imgCurrentDrive = currentDrive;
@@ -402,6 +435,21 @@ FileOperation fileBrowse_A(DirEntry* entry, const char *curdir) {
 					// Reload language to update button characters
 					langInit(true);
 					break;
+				} case FileOperation::restoreRamdrive: {
+					font->print(optionsCol, optionOffset + y, false, STR_RESTORING_RAMDRIVE, alignStart);
+					font->update(false);
+
+					if(!ramdriveRestore(entry->name.c_str())) {
+						font->clear(false);
+						font->print(firstCol, 0, false, STR_RAMDRIVE_RESTORE_FAILED + "\n\n" + STR_A_OK, alignStart);
+						font->update(false);
+
+						do {
+							swiWaitForVBlank();
+							scanKeys();
+						} while(!(keysDown() & KEY_A));
+					}
+					break;
 				} case FileOperation::calculateSHA1: {
 					u8 sha1[20] = {0};
 					char filePath[PATH_MAX];
@@ -631,6 +679,8 @@ std::string browseForFile (void) {
 		fileBrowse_drawBottomScreen(entry);
 		showDirectoryContents(dirContents, fileOffset, screenOffset, curdir);
 
+		iostats_trace_flush();
+
 		// Power saving loop. Only poll the keys once per frame and sleep the CPU if there is nothing else to do
 		do {
 			scanKeys();
@@ -692,10 +742,10 @@ std::string browseForFile (void) {
 				} else if (getOp == FileOperation::copySdOut
 						|| getOp == FileOperation::copyFatOut
 						|| (getOp == FileOperation::mountNitroFS && nitroMounted)
-						|| (getOp == FileOperation::mountImg && imgMounted)) {
+						|| ((getOp == FileOperation::mountImg || getOp == FileOperation::mountImgWritable) && imgMounted)) {
 					getDirectoryContents(dirContents); // Refresh directory listing
 					if ((getOp == FileOperation::mountNitroFS && nitroMounted)
-					 || (getOp == FileOperation::mountImg && imgMounted)) {
+					 || ((getOp == FileOperation::mountImg || getOp == FileOperation::mountImgWritable) && imgMounted)) {
 						screenOffset = 0;
 						fileOffset = 0;
 					}
@@ -940,7 +990,7 @@ std::string browseForFile (void) {
 			} else if (driveWritable(currentDrive) && fileBrowse_paste(curdir)) {
 				getDirectoryContents (dirContents);
 			}
-		} else if ((pressed & KEY_SELECT) && !clipboardUsed) {
+		} else if ((pressed & KEY_SELECT) && !(held & KEY_R) && !clipboardUsed) { // R+SELECT is the I/O stats overlay
 			clipboardOn = !clipboardOn;
 		} if (pressed & KEY_START) { // START menu
 			startMenu();
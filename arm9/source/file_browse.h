@@ -43,6 +43,7 @@ enum class FileOperation {
 	ndsInfo,
 	trimNds,
 	mountImg,
+	mountImgWritable,
 	restoreSaveNds,
 	restoreSaveGba,
 	showInfo,
@@ -51,6 +52,8 @@ enum class FileOperation {
 	calculateSHA1,
 	hexEdit,
 	loadFont,
+	restoreRamdrive,
+	restoreNand,
 };
 
 bool extension(const std::string_view filename, const std::vector<std::string_view> &extensions);
@@ -1,23 +1,216 @@
+#include "imgio.h"
 #include "tonccpy.h"
 
 #include <nds.h>
 #include <nds/disc_io.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <dirent.h>
 
 #define SECTOR_SIZE 512
-// #define WRITABLE
+
+// Requests longer than this are almost always file data rather than the
+// FAT and directory sectors libfat keeps coming back to, so they go
+// straight to the image file instead of flushing the whole cache
+#define IMG_CACHE_MAX_RUN 8
+
+// Entries are chained off buckets by sector, like nandio's cache
+#define IMG_CACHE_MAX 4096
+#define IMG_CACHE_NONE 0xFFFF
+
+typedef struct {
+	sec_t sector;
+	u32 lastUsed;
+	u16 next; // next entry in the same bucket
+	bool valid;
+	bool dirty;
+} ImgCacheEntry;
 
 char currentImgName[PATH_MAX];
 static FILE* imgFile;
+static bool imgWritable = false;
+
+static u32 cacheSize = IMG_CACHE_DEFAULT;
+static u32 cacheCount = 0;
+static u32 cacheTick = 0;
+static ImgCacheEntry *cacheEntries = NULL;
+static u16 *cacheBuckets = NULL;
+static u32 cacheBucketMask = 0;
+static u8 *cacheData = NULL;
+static bool imgShutdownOk = true;
+
+static bool img_file_read(sec_t sector, sec_t numSectors, void *buffer) {
+	if (fseek(imgFile, sector * SECTOR_SIZE, SEEK_SET) != 0)
+		return false;
+
+	// Images aren't always a whole number of sectors, pad the tail with zeros
+	size_t size = numSectors * SECTOR_SIZE;
+	size_t read = fread(buffer, 1, size, imgFile);
+	if (read < size)
+		toncset((u8 *)buffer + read, 0, size - read);
+
+	return true;
+}
+
+static bool img_file_write(sec_t sector, sec_t numSectors, const void *buffer) {
+	if (fseek(imgFile, sector * SECTOR_SIZE, SEEK_SET) != 0)
+		return false;
+
+	return fwrite(buffer, SECTOR_SIZE, numSectors, imgFile) == numSectors;
+}
+
+static int img_cache_find(sec_t sector) {
+	for (u16 i = cacheBuckets[sector & cacheBucketMask]; i != IMG_CACHE_NONE; i = cacheEntries[i].next) {
+		if (cacheEntries[i].sector == sector)
+			return i;
+	}
+
+	return -1;
+}
+
+static void img_cache_unlink(u32 index) {
+	u16 *link = &cacheBuckets[cacheEntries[index].sector & cacheBucketMask];
+	while (*link != index)
+		link = &cacheEntries[*link].next;
+	*link = cacheEntries[index].next;
+	cacheEntries[index].valid = false;
+	cacheEntries[index].dirty = false;
+}
+
+static bool img_cache_writeback(u32 index) {
+	ImgCacheEntry *entry = &cacheEntries[index];
+	if (!entry->dirty)
+		return true;
+
+	if (!img_file_write(entry->sector, 1, cacheData + index * SECTOR_SIZE))
+		return false;
+
+	entry->dirty = false;
+	return true;
+}
+
+static bool img_cache_insert(sec_t sector, const void *buffer, bool dirty) {
+	int index = img_cache_find(sector);
+
+	if (index < 0) {
+		// Take a free slot if there is one, otherwise the least recently used
+		index = 0;
+		for (u32 i = 0; i < cacheCount; i++) {
+			if (!cacheEntries[i].valid) {
+				index = i;
+				break;
+			}
+			if (cacheEntries[i].lastUsed < cacheEntries[index].lastUsed)
+				index = i;
+		}
+
+		if (cacheEntries[index].valid) {
+			if (!img_cache_writeback(index))
+				return false;
+			img_cache_unlink(index);
+		}
+
+		u16 *bucket = &cacheBuckets[sector & cacheBucketMask];
+		cacheEntries[index].sector = sector;
+		cacheEntries[index].next = *bucket;
+		cacheEntries[index].valid = true;
+		cacheEntries[index].dirty = false;
+		*bucket = index;
+	}
+
+	tonccpy(cacheData + index * SECTOR_SIZE, buffer, SECTOR_SIZE);
+	cacheEntries[index].lastUsed = ++cacheTick;
+	cacheEntries[index].dirty |= dirty;
+	return true;
+}
+
+static void img_cache_free(void) {
+	free(cacheEntries);
+	free(cacheBuckets);
+	free(cacheData);
+	cacheEntries = NULL;
+	cacheBuckets = NULL;
+	cacheData = NULL;
+	cacheCount = 0;
+	cacheBucketMask = 0;
+	cacheTick = 0;
+}
+
+static int img_cache_compare(const void *a, const void *b) {
+	sec_t sectorA = cacheEntries[*(const u32 *)a].sector;
+	sec_t sectorB = cacheEntries[*(const u32 *)b].sector;
+	return (sectorA > sectorB) - (sectorA < sectorB);
+}
+
+void img_set_cache_size(u32 sectors) {
+	cacheSize = sectors < IMG_CACHE_MAX ? sectors : IMG_CACHE_MAX;
+}
+
+void img_set_writable(bool writable) {
+	imgWritable = writable;
+
+	u32 features = FEATURE_MEDIUM_CANREAD | (writable ? FEATURE_MEDIUM_CANWRITE : 0);
+	io_img.features = features;
+	io_dsiware_save.features = features;
+}
+
+bool img_flush(void) {
+	if (!imgFile || cacheCount == 0)
+		return true;
+
+	// Write the dirty sectors back in order so the file is walked front to back
+	u32 *order = (u32 *)malloc(cacheCount * sizeof(u32));
+	u32 dirtyCount = 0;
+	bool success = true;
+	if (order) {
+		for (u32 i = 0; i < cacheCount; i++) {
+			if (cacheEntries[i].valid && cacheEntries[i].dirty)
+				order[dirtyCount++] = i;
+		}
+		qsort(order, dirtyCount, sizeof(u32), img_cache_compare);
+
+		for (u32 i = 0; i < dirtyCount; i++)
+			success &= img_cache_writeback(order[i]);
+
+		free(order);
+	} else {
+		for (u32 i = 0; i < cacheCount; i++)
+			success &= img_cache_writeback(i);
+	}
+
+	return (fflush(imgFile) == 0) && success;
+}
 
 bool img_startup() {
-#ifdef WRITABLE
-	imgFile = fopen(currentImgName, "rb+");
-#else
-	imgFile = fopen(currentImgName, "rb");
-#endif
-	return imgFile != NULL;
+	imgFile = fopen(currentImgName, imgWritable ? "rb+" : "rb");
+	if (!imgFile)
+		return false;
+
+	// The sector cache below does the buffering, stdio's would only add a copy
+	setvbuf(imgFile, NULL, _IONBF, 0);
+
+	imgShutdownOk = true;
+	img_cache_free();
+	if (cacheSize > 0) {
+		u32 buckets = 1;
+		while (buckets < cacheSize)
+			buckets <<= 1;
+
+		cacheEntries = (ImgCacheEntry *)calloc(cacheSize, sizeof(ImgCacheEntry));
+		cacheBuckets = (u16 *)malloc(buckets * sizeof(u16));
+		cacheData = (u8 *)malloc(cacheSize * SECTOR_SIZE);
+		if (cacheEntries && cacheBuckets && cacheData) {
+			cacheCount = cacheSize;
+			cacheBucketMask = buckets - 1;
+			for (u32 i = 0; i < buckets; i++)
+				cacheBuckets[i] = IMG_CACHE_NONE;
+		} else {
+			// Not enough RAM, run uncached rather than failing the mount
+			img_cache_free();
+		}
+	}
+
+	return true;
 }
 
 bool img_is_inserted() {
@@ -27,8 +220,40 @@ bool img_is_inserted() {
 bool img_read_sectors(sec_t sector, sec_t numSectors, void *buffer) {
 	if (!imgFile) return false;
 
-	fseek(imgFile, (sector << 9), SEEK_SET);
-	fread(buffer, 1, (numSectors << 9), imgFile);
+	if (cacheCount == 0)
+		return img_file_read(sector, numSectors, buffer);
+
+	u8 *dst = (u8 *)buffer;
+	while (numSectors > 0) {
+		int index = img_cache_find(sector);
+		if (index >= 0) {
+			tonccpy(dst, cacheData + index * SECTOR_SIZE, SECTOR_SIZE);
+			cacheEntries[index].lastUsed = ++cacheTick;
+			sector++;
+			dst += SECTOR_SIZE;
+			numSectors--;
+			continue;
+		}
+
+		// Read the whole run of uncached sectors in one go
+		sec_t run = 1;
+		while (run < numSectors && img_cache_find(sector + run) < 0)
+			run++;
+
+		if (!img_file_read(sector, run, dst))
+			return false;
+
+		if (run <= IMG_CACHE_MAX_RUN) {
+			for (sec_t i = 0; i < run; i++) {
+				if (!img_cache_insert(sector + i, dst + i * SECTOR_SIZE, false))
+					return false;
+			}
+		}
+
+		sector += run;
+		dst += run * SECTOR_SIZE;
+		numSectors -= run;
+	}
 
 	return true;
 }
@@ -43,15 +268,45 @@ bool dsiware_read_sectors(sec_t sector, sec_t numSectors, void *buffer) {
 }
 
 bool img_write_sectors(sec_t sector, sec_t numSectors, const void *buffer) {
-#ifdef WRITABLE
-	if (!imgFile) return false;
+	if (!imgFile || !imgWritable) return false;
+
+	if (cacheCount == 0 || numSectors > IMG_CACHE_MAX_RUN) {
+		// Write large runs through, dropping any cached copies they replace
+		for (sec_t i = 0; i < numSectors && cacheCount > 0; i++) {
+			int index = img_cache_find(sector + i);
+			if (index >= 0)
+				img_cache_unlink(index);
+		}
+
+		return img_file_write(sector, numSectors, buffer);
+	}
+
+	for (sec_t i = 0; i < numSectors; i++) {
+		if (!img_cache_insert(sector + i, buffer + i * SECTOR_SIZE, true))
+			return false;
+	}
 
-	fseek(imgFile, (sector << 9), SEEK_SET);
-	fwrite(buffer, 1, (numSectors << 9), imgFile);
 	return true;
-#else
-	return false;
-#endif
+}
+
+bool dsiware_write_sectors(sec_t sector, sec_t numSectors, const void *buffer) {
+	if (sector != 0)
+		return img_write_sectors(sector, numSectors, buffer);
+
+	// Put back whatever was at 0x36 before dsiware_read_sectors patched in 'FAT'
+	u8 bootSector[SECTOR_SIZE];
+	if (!img_read_sectors(0, 1, bootSector))
+		return false;
+
+	u8 original[3];
+	tonccpy(original, bootSector + 0x36, sizeof(original));
+	tonccpy(bootSector, buffer, SECTOR_SIZE);
+	tonccpy(bootSector + 0x36, original, sizeof(original));
+
+	if (!img_write_sectors(0, 1, bootSector))
+		return false;
+
+	return numSectors <= 1 || img_write_sectors(1, numSectors - 1, buffer + SECTOR_SIZE);
 }
 
 bool img_clear_status() {
@@ -59,20 +314,21 @@ bool img_clear_status() {
 }
 
 bool img_shutdown() {
+	// libfat may have shut the image down already when it was unmounted, so
+	// this keeps saying whether that last flush made it to the file
 	if (imgFile) {
-		fclose(imgFile);
+		imgShutdownOk = img_flush();
+		if (fclose(imgFile) != 0)
+			imgShutdownOk = false;
 		imgFile = NULL;
 	}
-	return true;
+	img_cache_free();
+	return imgShutdownOk;
 }
 
-const DISC_INTERFACE io_img = {
+DISC_INTERFACE io_img = {
 	('I' << 24) | ('M' << 16) | ('G' << 8) | 'F',
-#ifdef WRITABLE
-	FEATURE_MEDIUM_CANREAD | FEATURE_MEDIUM_CANWRITE,
-#else
 	FEATURE_MEDIUM_CANREAD,
-#endif
 	img_startup,
 	img_is_inserted,
 	img_read_sectors,
@@ -81,17 +337,13 @@ const DISC_INTERFACE io_img = {
 	img_shutdown
 };
 
-const DISC_INTERFACE io_dsiware_save = {
+DISC_INTERFACE io_dsiware_save = {
 	('I' << 24) | ('M' << 16) | ('G' << 8) | 'F',
-#ifdef WRITABLE
-	FEATURE_MEDIUM_CANREAD | FEATURE_MEDIUM_CANWRITE,
-#else
 	FEATURE_MEDIUM_CANREAD,
-#endif
 	img_startup,
 	img_is_inserted,
 	dsiware_read_sectors,
-	img_write_sectors,
+	dsiware_write_sectors,
 	img_clear_status,
 	img_shutdown
 };
@@ -7,10 +7,20 @@
 extern "C" {
 #endif
 
+// Default number of 512 byte sectors kept in the image sector cache
+#define IMG_CACHE_DEFAULT 64
+
 bool img_shutdown();
 
-extern const DISC_INTERFACE io_img;
-extern const DISC_INTERFACE io_dsiware_save;
+// Both only take effect on the next mount
+void img_set_cache_size(u32 sectors);
+void img_set_writable(bool writable);
+
+// Writes any dirty cached sectors back to the image file
+bool img_flush(void);
+
+extern DISC_INTERFACE io_img;
+extern DISC_INTERFACE io_dsiware_save;
 
 #ifdef __cplusplus
 }
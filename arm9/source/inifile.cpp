@@ -207,12 +207,67 @@ bool CIniFile::LoadIniFile(const std::string& FileName)
 
   fclose(f);
 
+  BuildIndex();
+
   m_bLastResult=false;
   m_bModified=false;
 
   return true;
 }
 
+static bool parseItem(const std::string& strline,std::string& strItem,size_t& equalsignPos)
+{
+  equalsignPos=strline.find('=');
+  if(equalsignPos==strline.npos) return false;
+
+  size_t last=equalsignPos?strline.find_last_not_of(" \t",equalsignPos-1):strline.npos;
+  if(last==strline.npos) strItem="";
+  else strItem=strline.substr(0,last+1);
+  return true;
+}
+
+void CIniFile::BuildIndex(void)
+{
+  m_Index.clear();
+
+  std::string strItem;
+  size_t equalsignPos;
+  cSectionIndex* section=NULL;
+  size_t iFileLines=m_FileContainer.size();
+
+  for(size_t ii=0;ii<iFileLines;ii++)
+  {
+    const std::string& strline=m_FileContainer[ii];
+
+    if(section&&parseItem(strline,strItem,equalsignPos))
+    {
+      // The first of any duplicates is the one that counts
+      section->keys.insert(std::make_pair(strItem,ii));
+      section->end=ii+1;
+    }
+    else if('['==strline[0])
+    {
+      section=NULL;
+      size_t rBracketPos=strline.find(']');
+      if(rBracketPos>0&&rBracketPos!=std::string::npos)
+      {
+        // Only the first section with a name is ever looked in
+        std::pair<cIndex::iterator,bool> added=m_Index.insert(std::make_pair(strline.substr(1,rBracketPos-1),cSectionIndex()));
+        if(added.second)
+        {
+          section=&added.first->second;
+          section->header=ii;
+          section->end=ii+1;
+        }
+      }
+    }
+    else if(section)
+    {
+      section->end=ii+1;
+    }
+  }
+}
+
 bool CIniFile::SaveIniFileModified(const std::string& FileName)
 {
   if(m_bModified==true)
@@ -260,128 +315,67 @@ bool CIniFile::SaveIniFile(const std::string& FileName)
 
 std::string CIniFile::GetFileString(const std::string& Section,const std::string& Item)
 {
-  std::string strline;
-  std::string strSection;
-  std::string strItem;
-  std::string strValue;
-
-  size_t ii=0;
-  size_t iFileLines=m_FileContainer.size();
-
-  if(m_bReadOnly)
-  {
-    cSectionCache::iterator it=m_Cache.find(Section);
-    if((it!=m_Cache.end())) ii=it->second;
-  }
-
   m_bLastResult=false;
 
-  if(iFileLines>0)
-  {
-    while(ii<iFileLines)
-    {
-      strline=m_FileContainer[ii++];
+  cIndex::const_iterator section=m_Index.find(Section);
+  if(section==m_Index.end()) return std::string("");
 
-      size_t rBracketPos=0;
-      if('['==strline[0]) rBracketPos=strline.find(']');
-      if(rBracketPos>0&&rBracketPos!=std::string::npos)
-      {
-        strSection=strline.substr(1,rBracketPos-1);
-        if(m_bReadOnly) m_Cache.insert(std::make_pair(strSection,ii-1));
-        if(strSection==Section)
-        {
-          while(ii<iFileLines)
-          {
-            strline=m_FileContainer[ii++];
-            size_t equalsignPos=strline.find('=');
-            if(equalsignPos!=strline.npos)
-            {
-              size_t last=equalsignPos?strline.find_last_not_of(" \t",equalsignPos-1):strline.npos;
-              if(last==strline.npos) strItem="";
-              else strItem=strline.substr(0,last+1);
-
-              if(strItem==Item)
-              {
-                size_t first=strline.find_first_not_of(" \t",equalsignPos+1);
-                if(first==strline.npos) strValue="";
-                else strValue=strline.substr(first);
-                m_bLastResult=true;
-                return strValue;
-              }
-            }
-            else if('['==strline[0])
-            {
-              break;
-            }
-          }
-          break;
-        }
-      }
-    }
-  }
-  return std::string("");
+  cKeyIndex::const_iterator item=section->second.keys.find(Item);
+  if(item==section->second.keys.end()) return std::string("");
+
+  const std::string& strline=m_FileContainer[item->second];
+  size_t first=strline.find_first_not_of(" \t",strline.find('=')+1);
+  m_bLastResult=true;
+  if(first==strline.npos) return std::string("");
+  return strline.substr(first);
 }
 
 void CIniFile::SetFileString(const std::string& Section,const std::string& Item,const std::string& Value)
 {
-  std::string strline;
-  std::string strSection;
-  std::string strItem;
-
   if(m_bReadOnly) return;
 
-  size_t ii=0;
-  size_t iFileLines=m_FileContainer.size();
-
-  while(ii<iFileLines)
+  cIndex::iterator section=m_Index.find(Section);
+  if(section==m_Index.end())
   {
-    strline=m_FileContainer[ii++];
+    size_t ii=m_FileContainer.size();
+    InsertLine(ii,"["+Section+"]");
+    InsertLine(ii+1,Item+" = "+Value);
+
+    cSectionIndex& added=m_Index[Section];
+    added.header=ii;
+    added.end=ii+2;
+    added.keys[Item]=ii+1;
+    return;
+  }
 
-    size_t rBracketPos=0;
-    if('['==strline[0]) rBracketPos=strline.find(']');
-    if(rBracketPos>0&&rBracketPos!=std::string::npos)
-    {
-      strSection=strline.substr(1,rBracketPos-1);
-      if(strSection==Section)
-      {
-        while(ii<iFileLines)
-        {
-          strline=m_FileContainer[ii++];
-          size_t equalsignPos=strline.find('=');
-          if(equalsignPos!=strline.npos)
-          {
-              size_t last=equalsignPos?strline.find_last_not_of(" \t",equalsignPos-1):strline.npos;
-              if(last==strline.npos) strItem="";
-              else strItem=strline.substr(0,last+1);
-
-              if(Item==strItem)
-              {
-                ReplaceLine(ii-1,Item+" = "+Value);
-                return;
-              }
-          }
-          else if('['==strline[0])
-          {
-            InsertLine(ii-1,Item+" = "+Value);
-            return;
-          }
-        }
-        InsertLine(ii,Item+" = "+Value);
-        return;
-      }
-    }
+  cKeyIndex::iterator item=section->second.keys.find(Item);
+  if(item!=section->second.keys.end())
+  {
+    ReplaceLine(item->second,Item+" = "+Value);
+    return;
   }
 
-  InsertLine(ii,"["+Section+"]");
-  InsertLine(ii+1,Item+" = "+Value);
-  return;
+  // At the end of the section, which then ends a line further down
+  size_t line=section->second.end;
+  InsertLine(line,Item+" = "+Value);
+  section->second.keys[Item]=line;
+  section->second.end++;
 }
 
-
-
 bool CIniFile::InsertLine(size_t line,const std::string& str)
 {
   m_FileContainer.insert(m_FileContainer.begin()+line,str);
+
+  // Everything from here on has moved down a line
+  for(cIndex::iterator section=m_Index.begin();section!=m_Index.end();++section)
+  {
+    if(section->second.header>=line) section->second.header++;
+    if(section->second.end>line) section->second.end++;
+    for(cKeyIndex::iterator item=section->second.keys.begin();item!=section->second.keys.end();++item)
+    {
+      if(item->second>=line) item->second++;
+    }
+  }
   return true;
 }
 
@@ -23,7 +23,7 @@
 
 #include <string>
 #include <vector>
-#include <map>
+#include <unordered_map>
 
 class CIniFile
 {
@@ -50,9 +50,19 @@ class CIniFile
     bool m_bLastResult;
     bool m_bModified;
     bool m_bReadOnly;
-    typedef std::map<std::string,size_t> cSectionCache;
-    cSectionCache m_Cache;
 
+    // Line numbers of every section and key, so lookups don't scan the file
+    typedef std::unordered_map<std::string,size_t> cKeyIndex;
+    struct cSectionIndex
+    {
+      size_t header;
+      size_t end; // line new keys go before
+      cKeyIndex keys;
+    };
+    typedef std::unordered_map<std::string,cSectionIndex> cIndex;
+    cIndex m_Index;
+
+    void BuildIndex(void);
     bool InsertLine(size_t line,const std::string& str);
     bool ReplaceLine(size_t line,const std::string& str);
 
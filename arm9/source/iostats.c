@@ -0,0 +1,184 @@
+#include "iostats.h"
+
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+
+static const DISC_INTERFACE *wrappedDisc[IOSTATS_DRIVES];
+static DISC_INTERFACE statsDisc[IOSTATS_DRIVES];
+static IoStats stats[IOSTATS_DRIVES];
+
+static char *tracePath = NULL;
+static IoTraceRecord *traceBuffer = NULL;
+static u32 traceSize = 0;
+static u32 traceHead = 0, traceTail = 0; // head == tail is empty
+static u32 traceDropped = 0;
+static bool traceFlushing = false;
+
+static void iostats_trace(IoStatsDrive drive, sec_t sector, sec_t numSectors, u32 start, u32 ticks, u8 flags) {
+	// Don't trace the trace file being written
+	if (!traceBuffer || traceFlushing)
+		return;
+
+	u32 next = (traceHead + 1) % traceSize;
+	if (next == traceTail) {
+		traceDropped++;
+		return;
+	}
+
+	IoTraceRecord *record = &traceBuffer[traceHead];
+	record->start = start;
+	record->ticks = ticks;
+	record->sector = sector;
+	record->count = numSectors;
+	record->drive = drive;
+	record->flags = flags;
+	record->reserved = 0;
+	traceHead = next;
+}
+
+static void iostats_count(IoStatsDrive drive, sec_t sector, sec_t numSectors, u32 start, bool write, bool success) {
+	IoStats *s = &stats[drive];
+	u32 ticks = cpuGetTiming() - start;
+	iostats_trace(drive, sector, numSectors, start, ticks, (write ? IOTRACE_WRITE : 0) | (success ? 0 : IOTRACE_FAILED));
+
+	if (write) {
+		s->writeRequests++;
+		s->sectorsWritten += numSectors;
+	} else {
+		s->readRequests++;
+		s->sectorsRead += numSectors;
+	}
+
+	s->busyTicks += ticks;
+	if (ticks > s->maxTicks)
+		s->maxTicks = ticks;
+
+	int bucket = 0;
+	while (bucket < IOSTATS_SIZE_BUCKETS - 1 && (numSectors >> (bucket + 1)) != 0)
+		bucket++;
+	s->sizeHistogram[bucket]++;
+}
+
+static bool iostats_read(IoStatsDrive drive, sec_t sector, sec_t numSectors, void *buffer) {
+	u32 start = cpuGetTiming();
+	bool success = wrappedDisc[drive]->readSectors(sector, numSectors, buffer);
+	iostats_count(drive, sector, numSectors, start, false, success);
+	return success;
+}
+
+static bool iostats_write(IoStatsDrive drive, sec_t sector, sec_t numSectors, const void *buffer) {
+	u32 start = cpuGetTiming();
+	bool success = wrappedDisc[drive]->writeSectors(sector, numSectors, buffer);
+	iostats_count(drive, sector, numSectors, start, true, success);
+	return success;
+}
+
+// The interface has no context pointer, so each drive needs its own pair
+#define IOSTATS_DRIVE_FUNCS(drive, name) \
+	static bool name##_read_sectors(sec_t sector, sec_t numSectors, void *buffer) { \
+		return iostats_read(drive, sector, numSectors, buffer); \
+	} \
+	static bool name##_write_sectors(sec_t sector, sec_t numSectors, const void *buffer) { \
+		return iostats_write(drive, sector, numSectors, buffer); \
+	}
+
+IOSTATS_DRIVE_FUNCS(IOSTATS_SD, sd)
+IOSTATS_DRIVE_FUNCS(IOSTATS_FLASHCARD, flashcard)
+IOSTATS_DRIVE_FUNCS(IOSTATS_RAMDRIVE, ramdrive)
+IOSTATS_DRIVE_FUNCS(IOSTATS_NAND, nand)
+IOSTATS_DRIVE_FUNCS(IOSTATS_IMAGE, image)
+
+static const FN_MEDIUM_READSECTORS readFuncs[IOSTATS_DRIVES] = {
+	sd_read_sectors,
+	flashcard_read_sectors,
+	ramdrive_read_sectors,
+	nand_read_sectors,
+	image_read_sectors,
+};
+
+static const FN_MEDIUM_WRITESECTORS writeFuncs[IOSTATS_DRIVES] = {
+	sd_write_sectors,
+	flashcard_write_sectors,
+	ramdrive_write_sectors,
+	nand_write_sectors,
+	image_write_sectors,
+};
+
+const DISC_INTERFACE *iostats_wrap(IoStatsDrive drive, const DISC_INTERFACE *disc) {
+	memset(&stats[drive], 0, sizeof(IoStats));
+
+	// Everything but the sector transfers goes straight to the drive
+	wrappedDisc[drive] = disc;
+	statsDisc[drive] = *disc;
+	statsDisc[drive].readSectors = readFuncs[drive];
+	statsDisc[drive].writeSectors = writeFuncs[drive];
+
+	return &statsDisc[drive];
+}
+
+const IoStats *iostats_get(IoStatsDrive drive) {
+	return &stats[drive];
+}
+
+bool iostats_trace_start(const char *path) {
+	iostats_trace_stop();
+
+	FILE *file = fopen(path, "wb");
+	if (!file)
+		return false;
+
+	IoTraceHeader header = {IOTRACE_MAGIC, IOTRACE_VERSION, BUS_CLOCK, sizeof(IoTraceRecord)};
+	bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+	if (fclose(file) != 0 || !success)
+		return false;
+
+	// Halve the buffer until it fits
+	for (traceSize = IOTRACE_BUFFER_RECORDS; traceSize > 1; traceSize /= 2) {
+		traceBuffer = (IoTraceRecord *)malloc(traceSize * sizeof(IoTraceRecord));
+		if (traceBuffer)
+			break;
+	}
+	if (!traceBuffer)
+		return false;
+
+	tracePath = strdup(path);
+	traceHead = traceTail = 0;
+	traceDropped = 0;
+	return true;
+}
+
+void iostats_trace_flush(void) {
+	if (!traceBuffer || (traceHead == traceTail && traceDropped == 0))
+		return;
+
+	traceFlushing = true;
+	FILE *file = fopen(tracePath, "ab");
+	if (file) {
+		// The ring wraps at most once, so this is two runs at most
+		while (traceTail != traceHead) {
+			u32 end = traceHead > traceTail ? traceHead : traceSize;
+			fwrite(&traceBuffer[traceTail], sizeof(IoTraceRecord), end - traceTail, file);
+			traceTail = end % traceSize;
+		}
+
+		if (traceDropped > 0) {
+			IoTraceRecord dropped = {cpuGetTiming(), 0, 0, traceDropped, 0, IOTRACE_DROPPED, 0};
+			fwrite(&dropped, sizeof(dropped), 1, file);
+			traceDropped = 0;
+		}
+
+		fclose(file);
+	}
+	traceFlushing = false;
+}
+
+void iostats_trace_stop(void) {
+	iostats_trace_flush();
+
+	free(traceBuffer);
+	free(tracePath);
+	traceBuffer = NULL;
+	tracePath = NULL;
+	traceSize = 0;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <nds.h>
+#include <nds/disc_io.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	IOSTATS_SD,
+	IOSTATS_FLASHCARD,
+	IOSTATS_RAMDRIVE,
+	IOSTATS_NAND,
+	IOSTATS_IMAGE,
+	IOSTATS_DRIVES
+} IoStatsDrive;
+
+// Request sizes by power of two: 1, 2-3, 4-7, ... 128+ sectors
+#define IOSTATS_SIZE_BUCKETS 8
+
+// Totals since the drive was last wrapped, times are in cpuGetTiming()
+// ticks, which has to be running
+typedef struct {
+	u32 readRequests;
+	u32 writeRequests;
+	u32 sectorsRead;
+	u32 sectorsWritten;
+	u64 busyTicks;
+	u32 maxTicks;
+	u32 sizeHistogram[IOSTATS_SIZE_BUCKETS];
+} IoStats;
+
+// Wraps a drive's interface so every read and write is counted and timed
+const DISC_INTERFACE *iostats_wrap(IoStatsDrive drive, const DISC_INTERFACE *disc);
+
+const IoStats *iostats_get(IoStatsDrive drive);
+
+// Trace file layout, tools/iotrace/replay.c reads it. A header, then one
+// record per request in the order they ran.
+#define IOTRACE_MAGIC 0x54394D47 // 'GM9T'
+#define IOTRACE_VERSION 1
+
+typedef struct {
+	u32 magic;
+	u32 version;
+	u32 tickRate; // timer ticks per second
+	u32 recordSize;
+} IoTraceHeader;
+
+#define IOTRACE_WRITE BIT(0)
+#define IOTRACE_FAILED BIT(1)
+#define IOTRACE_DROPPED BIT(2) // not a request, count is how many were lost
+
+typedef struct {
+	u32 start; // ticks, wraps every couple of minutes
+	u32 ticks;
+	u32 sector;
+	u32 count;
+	u8 drive;
+	u8 flags;
+	u16 reserved;
+} IoTraceRecord;
+
+// Largest trace buffer tried, in records
+#define IOTRACE_BUFFER_RECORDS 8192
+
+// Starts recording every request on every drive, the trace file is
+// rewritten from the beginning
+bool iostats_trace_start(const char *path);
+
+// Appends what's been recorded since the last flush to the trace file.
+// Call it from somewhere no drive is in the middle of a request.
+void iostats_trace_flush(void);
+
+void iostats_trace_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
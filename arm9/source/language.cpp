@@ -1,10 +1,13 @@
 #include <nds.h>
+#include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <fat.h>
 #include <sys/stat.h>
 #include <string.h>
 #include <unistd.h>
 #include <string>
+#include <vector>
 
 #include "config.h"
 #include "font.h"
@@ -20,90 +23,252 @@ int lastCol = -1;
 Alignment alignStart = Alignment::left;
 Alignment alignEnd = Alignment::right;
 
+// String IDs in language.inl order, which is how language packs index them
+enum LanguageStringId {
+#define STRING(what, def) STRID_##what,
+#include "language.inl"
+#undef STRING
+	STRID_COUNT
+};
+
+// Precompiled language.ini, made by tools/langpack.py
+struct LanguagePackHeader {
+	char magic[4];
+	u16 version;
+	u16 count;
+	u32 idHash;
+	u32 iniSize;
+	u32 iniHash;
+	u32 flags;
+};
+
+#define LANGUAGE_PACK_VERSION 2
+#define LANGUAGE_PACK_RTL BIT(0)
+
+struct GlyphFallback {
+	char16_t glyph;
+	const char *utf8;
+	const char *fallback;
+};
+
+// Button glyphs and what to show if the font doesn't have them
+static const GlyphFallback glyphFallbacks[] = {
+	{u'\uE000', "\uE000", "<A>"},
+	{u'\uE001', "\uE001", "<B>"},
+	{u'\uE002', "\uE002", "<X>"},
+	{u'\uE003', "\uE003", "<Y>"},
+	{u'\uE004', "\uE004", "<L>"},
+	{u'\uE005', "\uE005", "<R>"},
+	{u'\uE006', "\uE006", "←↑↓→"},
+	{u'\uE079', "\uE079", "↑"},
+	{u'\uE07A', "\uE07A", "↓"},
+	{u'\uE07B', "\uE07B", "←"},
+	{u'\uE07C', "\uE07C", "→"},
+	{u'\uE07D', "\uE07D", "↑↓"},
+	{u'\uE07E', "\uE07E", "←→"},
+};
+
+/**
+ * Replace any button glyphs the font doesn't have with text
+ */
+static void applyGlyphFallbacks(std::string &str, const std::vector<const GlyphFallback *> &missing) {
+	for(const GlyphFallback *glyph : missing) {
+		size_t pos = 0;
+		while((pos = str.find(glyph->utf8, pos)) != std::string::npos) {
+			str.replace(pos, strlen(glyph->utf8), glyph->fallback);
+			pos += strlen(glyph->fallback);
+		}
+	}
+}
+
 /**
  * Get strings from the ini with special processing
  */
 std::string getString(CIniFile &ini, const std::string &item, const std::string &defaultValue) {
-	std::string out = ini.GetString("LANGUAGE", item, defaultValue);
+	std::string in = ini.GetString("LANGUAGE", item, defaultValue);
+	std::string out;
+	out.reserve(in.length());
 
-	// Convert "\n" to actual newlines
-	for(uint i = 0; i < out.length() - 1; i++) {
-		if(out[i] == '\\') {
-			switch(out[i + 1]) {
+	// Convert "\n" to actual newlines and button names to their glyphs,
+	// tools/langpack.py does the same for language packs
+	for(size_t i = 0; i < in.length(); i++) {
+		char next = i + 1 < in.length() ? tolower(in[i + 1]) : 0;
+		if(in[i] == '\\' && next != 0 && strchr("nabxylrd", next)) {
+			i++;
+			switch(next) {
 				case 'n':
-				case 'N':
-					out = out.substr(0, i) + '\n' + out.substr(i + 2);
+					out += '\n';
 					break;
 				case 'a':
-				case 'A':
-					out = out.substr(0, i) + (font->charExists(u'') ? "" : "<A>") + out.substr(i + 2); // U+E000
+					out += "\uE000";
 					break;
 				case 'b':
-				case 'B':
-					out = out.substr(0, i) + (font->charExists(u'') ? "" : "<B>") + out.substr(i + 2); // U+E001
+					out += "\uE001";
 					break;
 				case 'x':
-				case 'X':
-					out = out.substr(0, i) + (font->charExists(u'') ? "" : "<X>") + out.substr(i + 2); // U+E002
+					out += "\uE002";
 					break;
 				case 'y':
-				case 'Y':
-					out = out.substr(0, i) + (font->charExists(u'') ? "" : "<Y>") + out.substr(i + 2); // U+E003
+					out += "\uE003";
 					break;
 				case 'l':
-				case 'L':
-					out = out.substr(0, i) + (font->charExists(u'') ? "" : "<L>") + out.substr(i + 2); // U+E004
+					out += "\uE004";
 					break;
 				case 'r':
-				case 'R':
-					out = out.substr(0, i) + (font->charExists(u'') ? "" : "<R>") + out.substr(i + 2); // U+E005
+					out += "\uE005";
 					break;
 				case 'd':
-				case 'D':
-					switch(out[i + 2]) {
+					switch(i + 1 < in.length() ? tolower(in[i + 1]) : 0) {
 						default:
-							out = out.substr(0, i) + (font->charExists(u'') ? "" : "←↑↓→") + out.substr(i + 2); // U+E006
+							out += "\uE006";
 							break;
 						case 'u':
-						case 'U':
-							out = out.substr(0, i) + (font->charExists(u'') ? "" : "↑") + out.substr(i + 3); // U+E079
+							out += "\uE079";
+							i++;
 							break;
 						case 'd':
-						case 'D':
-							out = out.substr(0, i) + (font->charExists(u'') ? "" : "↓") + out.substr(i + 3); // U+E07A
+							out += "\uE07A";
+							i++;
 							break;
 						case 'l':
-						case 'L':
-							out = out.substr(0, i) + (font->charExists(u'') ? "" : "←") + out.substr(i + 3); // U+E07B
+							out += "\uE07B";
+							i++;
 							break;
 						case 'r':
-						case 'R':
-							out = out.substr(0, i) + (font->charExists(u'') ? "" : "→") + out.substr(i + 3); // U+E07C
+							out += "\uE07C";
+							i++;
 							break;
 						case 'v':
-						case 'V':
-							out = out.substr(0, i) + (font->charExists(u'') ? "" : "↑↓") + out.substr(i + 3); // U+E07D
+							out += "\uE07D";
+							i++;
 							break;
 						case 'h':
-						case 'H':
-							out = out.substr(0, i) + (font->charExists(u'') ? "" : "←→") + out.substr(i + 3); // U+E07E
+							out += "\uE07E";
+							i++;
 							break;
 					}
-				default:
 					break;
 			}
-		} else if(out[i] == '&') {
-			if(out.substr(i + 1, 3) == "lrm") {
-				out = out.substr(0, i) + "\u200E" + out.substr(i + 4); // Left-to-Right mark
-			} else if(out.substr(i + 1, 3) == "rlm") {
-				out = out.substr(0, i) + "\u200F" + out.substr(i + 4); // Right-to-Left mark
-			}
+		} else if(in[i] == '&' && in.compare(i + 1, 3, "lrm") == 0) {
+			out += "\u200E"; // Left-to-Right mark
+			i += 3;
+		} else if(in[i] == '&' && in.compare(i + 1, 3, "rlm") == 0) {
+			out += "\u200F"; // Right-to-Left mark
+			i += 3;
+		} else {
+			out += in[i];
 		}
 	}
 
 	return out;
 }
 
+#define FNV1A_INIT 0x811C9DC5
+
+static u32 fnv1a(u32 hash, const u8 *data, size_t len) {
+	for(size_t i = 0; i < len; i++)
+		hash = (hash ^ data[i]) * 0x01000193;
+	return hash;
+}
+
+/**
+ * FNV-1a of the string names, so a pack built against a different
+ * language.inl isn't used
+ */
+static u32 langIdHash(void) {
+	static const char names[] =
+#define STRING(what, def) #what "\n"
+#include "language.inl"
+#undef STRING
+	;
+
+	return fnv1a(FNV1A_INIT, (const u8 *)names, sizeof(names) - 1);
+}
+
+/**
+ * Whether the ini is still the one the pack was built from, the size
+ * alone misses edits that keep the length
+ */
+static bool langIniMatches(const std::string &iniPath, const LanguagePackHeader *header) {
+	struct stat st;
+	if(stat(iniPath.c_str(), &st) != 0)
+		return true; // Only the pack was shipped
+	if((u32)st.st_size != header->iniSize)
+		return false;
+
+	FILE *file = fopen(iniPath.c_str(), "rb");
+	if(!file)
+		return false;
+
+	u8 buffer[512];
+	u32 hash = FNV1A_INIT;
+	size_t numr;
+	while((numr = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		hash = fnv1a(hash, buffer, numr);
+	fclose(file);
+
+	return hash == header->iniHash;
+}
+
+/**
+ * Load the language.bin next to the ini, if there is one and it's up to
+ * date with both the ini and this build
+ */
+static bool langLoadPack(const std::string &iniPath) {
+	std::string packPath = iniPath.substr(0, iniPath.rfind('.')) + ".bin";
+	FILE *file = fopen(packPath.c_str(), "rb");
+	if(!file)
+		return false;
+
+	fseek(file, 0, SEEK_END);
+	size_t size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	size_t dataStart = sizeof(LanguagePackHeader) + STRID_COUNT * sizeof(u32);
+	if(size <= dataStart) {
+		fclose(file);
+		return false;
+	}
+
+	char *pack = (char *)malloc(size);
+	if(!pack) {
+		fclose(file);
+		return false;
+	}
+
+	bool valid = fread(pack, 1, size, file) == size;
+	fclose(file);
+
+	const LanguagePackHeader *header = (const LanguagePackHeader *)pack;
+	valid = valid && memcmp(header->magic, "GM9L", 4) == 0
+		&& header->version == LANGUAGE_PACK_VERSION
+		&& header->count == STRID_COUNT
+		&& header->idHash == langIdHash()
+		&& pack[size - 1] == '\0';
+
+	// Someone's edited the ini since
+	if(valid && !langIniMatches(iniPath, header))
+		valid = false;
+
+	const u32 *offsets = (const u32 *)(pack + sizeof(LanguagePackHeader));
+	const char *data = pack + dataStart;
+	for(int i = 0; valid && i < STRID_COUNT; i++) {
+		if(offsets[i] >= size - dataStart)
+			valid = false;
+	}
+
+	if(valid) {
+#define STRING(what, def) STR_##what = data + offsets[STRID_##what];
+#include "language.inl"
+#undef STRING
+
+		rtl = header->flags & LANGUAGE_PACK_RTL;
+	}
+
+	free(pack);
+	return valid;
+}
+
 /**
  * Initialize translations.
  * Uses the language ID specified in settings.ui.language.
@@ -113,13 +278,29 @@ void langInit(bool reloading) {
 	if(reloading && access(config->languageIniPath().c_str(), F_OK) != 0)
 		return;
 
-	CIniFile languageini(config->languageIniPath());
+	// User supplied translations won't have a pack, so read the ini
+	if(!langLoadPack(config->languageIniPath())) {
+		CIniFile languageini(config->languageIniPath());
 
 #define STRING(what, def) STR_##what = getString(languageini, ""#what, def);
 #include "language.inl"
 #undef STRING
 
-	rtl = languageini.GetString("PROPERTIES", "DIR", "ltr") == "rtl";
+		rtl = languageini.GetString("PROPERTIES", "DIR", "ltr") == "rtl";
+	}
+
+	std::vector<const GlyphFallback *> missing;
+	for(const GlyphFallback &glyph : glyphFallbacks) {
+		if(!font->charExists(glyph.glyph))
+			missing.push_back(&glyph);
+	}
+
+	if(!missing.empty()) {
+#define STRING(what, def) applyGlyphFallbacks(STR_##what, missing);
+#include "language.inl"
+#undef STRING
+	}
+
 	if(rtl) {
 		firstCol = -1;
 		lastCol = 0;
@@ -59,7 +59,11 @@ STRING(GBA_GAME, "(GBA Game, %s)")
 STRING(NDS_GAME, "(NDS Game, %s (%s trimmed))")
 STRING(GAME_VIRTUAL, "(Game Virtual)")
 STRING(RAMDRIVE_FAT, "(RAMdrive FAT, %s)")
+STRING(RAMDRIVE_COMPRESSED, "Compressed: %s in %s of %s")
 STRING(SYSNAND_FAT, "(SysNAND FAT, %s)")
+STRING(NAND_CACHE_HITS, "Cache: %lu%% of %lu sectors")
+STRING(DLDI_REALIGNED, "Realigned: %lu of %lu requests")
+STRING(IO_STATS_HEADER, "Drive MB/s  Card    ms Sizes")
 STRING(FAT_IMAGE, "(Image FAT, %s)")
 
 // Bottom screen control info
@@ -72,6 +76,9 @@ STRING(POWERTEXT, "POWER - Reboot/[+held] Poweroff")
 STRING(POWERTEXT_3DS, "POWER - Sleep Mode screen")
 STRING(HOMETEXT, "HOME - HOME Menu prompt")
 STRING(IMAGETEXT, "\\R+\\X - Unmount image")
+STRING(CARD_NITROFS_TEXT, "\\R+\\A - Mount NitroFS")
+STRING(RAMDRIVE_SNAPSHOT_TEXT, "\\R+\\A - Save snapshot")
+STRING(NAND_BACKUP_TEXT, "\\R+\\A - Back up NAND")
 STRING(SCREENSHOTTEXT, "\\R+\\L - Make a screenshot")
 STRING(CLEAR_CLIPBOARD, "SELECT - Clear clipboard")
 STRING(RESTORE_CLIPBOARD, "SELECT - Restore clipboard")
@@ -104,12 +111,15 @@ STRING(RESTORE_SAVE, "Restore save")
 STRING(RESTORE_SAVE_NDS, "Restore save (Slot-1)")
 STRING(RESTORE_SAVE_GBA, "Restore save (Slot-2)")
 STRING(MOUNT_FAT_IMG, "Mount as FAT image")
+STRING(MOUNT_FAT_IMG_WRITABLE, "Mount as FAT image (writable)")
 STRING(OPEN_HEX, "Open in hex editor")
 STRING(SHOW_DIRECTORY_INFO, "Show directory info")
 STRING(SHOW_FILE_INFO, "Show file info")
 STRING(COPY_SD_OUT, "Copy to sd:/gm9i/out")
 STRING(COPY_FAT_OUT, "Copy to fat:/gm9i/out")
 STRING(CALC_SHA1, "Calculate SHA1 hash")
+STRING(RESTORE_RAMDRIVE, "Restore to RAM drive")
+STRING(RESTORE_NAND, "Restore to NAND")
 STRING(LOAD_FONT, "Load font")
 
 // File info
@@ -179,6 +189,31 @@ STRING(SWITCH_CART_TO_SECTION, "Please switch to the GBA cart containing section
 STRING(SWITCH_CART_TO_SECTION_THIS_WAS, "Please switch to the GBA cart containing section %d. (This was section %d)")
 STRING(WRONG_DS_SAVE, "This cart contains a save file from a different DS game.")
 STRING(NO_DS_SAVE, "This cart doesn't contain a DS save.")
+STRING(DUMP_N_TITLES_TO, "Dump %d titles to\n\"%s:/gm9i/out\"?")
+STRING(DUMPING_N_OF_N, "Dumping file %d/%d:")
+STRING(TIME_REMAINING, "Time remaining: %lu:%02lu")
+STRING(TITLES_TOO_BIG, "The selected titles need %s, but only %s is free on this drive.")
+STRING(FAILED_TO_DUMP_X, "Failed to dump %s.")
+STRING(SAVING_RAMDRIVE, "Saving RAM drive snapshot...")
+STRING(RAMDRIVE_SAVED_TO, "RAM drive snapshot saved to\n\"%s\"")
+STRING(RAMDRIVE_SAVE_FAILED, "Failed to save the RAM drive snapshot.")
+STRING(RESTORING_RAMDRIVE, "Restoring RAM drive...")
+STRING(RAMDRIVE_RESTORE_FAILED, "Failed to restore the RAM drive snapshot. It may be from a different size of RAM drive.")
+STRING(BACKUP_NAND_TO, "Back up the NAND (%s) to\n\"%s:/gm9i/out\"?")
+STRING(BACKING_UP_NAND, "Backing up NAND...")
+STRING(NAND_BACKUP_SAVED_TO, "NAND backup saved to\n\"%s\"")
+STRING(NAND_BACKUP_NO_SPACE, "Not enough free space for the NAND backup.")
+STRING(NAND_BACKUP_FAILED, "Failed to back up the NAND.")
+STRING(NAND_BACKUP_OTHER_CONSOLE, "This is not a NAND backup of this console.")
+STRING(RESTORE_NAND_CONFIRM, "Restore the NAND from this backup?\nOnly sectors that differ are written.")
+STRING(COMPARING_NAND, "Comparing the backup with the NAND...")
+STRING(NAND_BACKUP_CORRUPT, "The NAND backup does not match its SHA1 file.")
+STRING(NAND_ALREADY_MATCHES, "The NAND already matches this backup.")
+STRING(RESTORING_NAND, "Restoring NAND...")
+STRING(DO_NOT_TURN_OFF_POWER, "Do not turn off the power.")
+STRING(NAND_RESTORED, "NAND restored, %lu sectors written.")
+STRING(NAND_RESTORE_FAILED, "Failed to restore the NAND. Do not turn off the power, try restoring again.")
+STRING(IMG_WRITE_BACK_FAILED, "Failed to write changes back to the image, some may be lost.")
 
 // Confirmation/option button info
 STRING(A_OK, "(\\A OK)")
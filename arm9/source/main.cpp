@@ -4,6 +4,7 @@
 #include <fat.h>
 #include <sys/stat.h>
 #include <limits.h>
+#include <algorithm>
 
 #include <string.h>
 #include <unistd.h>
@@ -16,8 +17,10 @@
 #include "file_browse.h"
 #include "fileOperations.h"
 #include "font.h"
+#include "iostats.h"
 #include "language.h"
 #include "my_sd.h"
+#include "nandio.h"
 #include "nitrofs.h"
 #include "tonccpy.h"
 #include "version.h"
@@ -42,6 +45,101 @@ bool applaunch = false;
 
 static int bg3;
 
+// Boot profile, timer ticks at the end of each stage
+#define BOOT_STAGES_MAX 16
+static const char *bootStageNames[BOOT_STAGES_MAX];
+static u32 bootStageTicks[BOOT_STAGES_MAX];
+static int bootStageCount = 0;
+
+//---------------------------------------------------------------------------------
+static void bootStage(const char *name) {
+//---------------------------------------------------------------------------------
+	if (bootStageCount < BOOT_STAGES_MAX) {
+		bootStageNames[bootStageCount] = name;
+		bootStageTicks[bootStageCount] = cpuGetTiming();
+		bootStageCount++;
+	}
+}
+
+//---------------------------------------------------------------------------------
+static void bootProfileSave(const char *path) {
+//---------------------------------------------------------------------------------
+	FILE *log = fopen(path, "w");
+	if (!log)
+		return;
+
+	fprintf(log, "%s\n\n%-12s %10s %10s\n", titleName, "stage", "end (us)", "took (us)");
+	u32 prevTicks = 0;
+	for (int i = 0; i < bootStageCount; i++) {
+		fprintf(log, "%-12s %10lu %10lu\n", bootStageNames[i], timerTicks2usec(bootStageTicks[i]), timerTicks2usec(bootStageTicks[i] - prevTicks));
+		prevTicks = bootStageTicks[i];
+	}
+	fclose(log);
+}
+
+// I/O statistics overlay, SELECT while holding R toggles it
+static bool ioStatsShown = false;
+static bool ioStatsSelectHeld = false;
+static int ioStatsFrames = 0;
+static u32 ioStatsTicks = 0;
+static IoStats ioStatsPrev[IOSTATS_DRIVES];
+
+//---------------------------------------------------------------------------------
+static void ioStatsDraw(bool clear) {
+//---------------------------------------------------------------------------------
+	static const char *driveNames[IOSTATS_DRIVES] = {"sd", "fat", "ram", "nand", "img"};
+	int cols = SCREEN_COLS;
+	int row = -1 - IOSTATS_DRIVES;
+
+	if (clear) {
+		for (int i = 0; i <= IOSTATS_DRIVES; i++)
+			font->printf(0, row + i, true, Alignment::left, Palette::white, "%*c", cols, ' ');
+		return;
+	}
+
+	font->printf(0, row, true, Alignment::left, Palette::blackGreen, "%-*s", cols, STR_IO_STATS_HEADER.c_str());
+
+	// Rates are over the time since the last draw, sizes since the mount
+	u32 now = cpuGetTiming();
+	u32 wallTicks = now - ioStatsTicks;
+	ioStatsTicks = now;
+
+	for (int drive = 0; drive < IOSTATS_DRIVES; drive++) {
+		const IoStats *stats = iostats_get((IoStatsDrive)drive);
+		IoStats *prev = &ioStatsPrev[drive];
+
+		// A remount resets the totals
+		if (stats->sectorsRead < prev->sectorsRead || stats->sectorsWritten < prev->sectorsWritten)
+			memset(prev, 0, sizeof(IoStats));
+
+		u32 requests = (stats->readRequests + stats->writeRequests) - (prev->readRequests + prev->writeRequests);
+		u64 bytes = (u64)((stats->sectorsRead + stats->sectorsWritten) - (prev->sectorsRead + prev->sectorsWritten)) * 512;
+		u32 busyTicks = stats->busyTicks - prev->busyTicks;
+		*prev = *stats;
+
+		// In hundredths of a MB/s, what's moving overall and what the
+		// drive manages while it's busy
+		u32 rate = wallTicks ? std::min<u64>(bytes * BUS_CLOCK / 10486 / wallTicks, 9999) : 0;
+		u32 cardRate = busyTicks ? std::min<u64>(bytes * BUS_CLOCK / 10486 / busyTicks, 9999) : 0;
+		u32 latency = requests ? std::min<u32>(timerTicks2usec(busyTicks / requests) / 100, 9999) : 0; // tenths of a ms
+
+		u32 total = 0;
+		for (int i = 0; i < IOSTATS_SIZE_BUCKETS; i++)
+			total += stats->sizeHistogram[i];
+
+		// Share of requests in each size bucket, . for none through 9
+		char sizes[IOSTATS_SIZE_BUCKETS + 1];
+		for (int i = 0; i < IOSTATS_SIZE_BUCKETS; i++) {
+			u32 count = stats->sizeHistogram[i];
+			sizes[i] = count ? '0' + (count * 9 + total - 1) / total : '.';
+		}
+		sizes[IOSTATS_SIZE_BUCKETS] = '\0';
+
+		font->printf(0, row + 1 + drive, true, Alignment::left, Palette::white, "%-5s%2lu.%02lu %2lu.%02lu %3lu.%lu %s%*c",
+			driveNames[drive], rate / 100, rate % 100, cardRate / 100, cardRate % 100, latency / 10, latency % 10, sizes, cols - 31, ' ');
+	}
+}
+
 //---------------------------------------------------------------------------------
 void stop (void) {
 //---------------------------------------------------------------------------------
@@ -65,6 +163,25 @@ void vblankHandler (void) {
 		romSize[1] = 0;
 	}
 
+	// Toggle the I/O statistics overlay, the menus don't all scan keys
+	// so this reads them directly. R on its own is only a modifier and
+	// the menus leave SELECT alone while it's held, L+R is the screenshot
+	u32 ioStatsKeys = ~REG_KEYINPUT;
+	bool ioStatsSelect = ioStatsKeys & KEY_SELECT;
+	if ((ioStatsKeys & KEY_R) && ioStatsSelect && !ioStatsSelectHeld && font) {
+		ioStatsShown = !ioStatsShown;
+		ioStatsDraw(!ioStatsShown);
+		ioStatsFrames = 0;
+		font->update(true);
+	}
+	ioStatsSelectHeld = ioStatsSelect;
+
+	if (ioStatsShown && font && ++ioStatsFrames >= 30) {
+		ioStatsFrames = 0;
+		ioStatsDraw(false);
+		font->update(true);
+	}
+
 	// Print time
 	std::string time = RetTime();
 	if(time != prevTime) {
@@ -86,9 +203,13 @@ int main(int argc, char **argv) {
 
 	defaultExceptionHandler();
 
+	// Timers 2 and 3, for the boot profile
+	cpuStartTiming(2);
+
 	std::string filename;
 	
 	bool yHeld = false;
+	bool ram32MB = false;
 
 	sprintf(titleName, "GodMode9i %s", VER_NUMBER);
 
@@ -122,10 +243,16 @@ int main(int argc, char **argv) {
 	u16 arm7_SNDEXCNT = fifoGetValue32(FIFO_USER_07);
 	if (arm7_SNDEXCNT != 0) isRegularDS = false;	// If sound frequency setting is found, then the console is not a DS Phat/Lite
 	fifoSendValue32(FIFO_USER_07, 0);
+	bootStage("arm7");
 
+	// The ARM7 can get the NAND going while the SD card mounts
+	nandio_request_cid();
+
+	bool splashHint = false;
 	if (isDSiMode()) {
 		// bios9iEnabled = true;
 		if (!arm7SCFGLocked) {
+			splashHint = true;
 			//font->print(-2, -4, false, " Held - Disable NAND access", Alignment::right);
 			font->print(-2, -3, false, " Held - Disable cart access", Alignment::right);
 			font->print(-2, -2, false, "Do this if it crashes here", Alignment::right);
@@ -135,18 +262,9 @@ int main(int argc, char **argv) {
 		}*/
 	}
 
-	// Display for 2 seconds
-	font->update(false);
-	for (int i = 0; i < 60*2; i++) {
-		swiWaitForVBlank();
-	}
-
-	font->clear(false);
-	font->print(1, 1, false, titleName);
-	font->print(1, 2, false, "----------------------------------------");
-	font->print(1, 3, false, "https://github.com/DS-Homebrew/GodMode9i");
-	font->print(-2, -2, false, "Mounting drive(s)...", Alignment::right);
+	// The SD card, RAM drive and NAND mount while the splash is up
 	font->update(false);
+	u32 splashTicks = cpuGetTiming();
 
 	sysSetCartOwner (BUS_OWNER_ARM9);	// Allow arm9 to access GBA ROM
 
@@ -156,18 +274,19 @@ int main(int argc, char **argv) {
 			sdMounted = sdMount();
 		}
 	}
+	bootStage("sd");
 	if (isDSiMode()) {
-		scanKeys();
-		yHeld = (keysHeld() & KEY_Y);
 		*(vu32*)(0x0DFFFE0C) = 0x474D3969;		// Check for 32MB of RAM
-		bool ram32MB = *(vu32*)(0x0DFFFE0C) == 0x474D3969;
+		ram32MB = *(vu32*)(0x0DFFFE0C) == 0x474D3969;
 		ramdriveMount(ram32MB);
 		if (ram32MB) {
 			is3DS = fifoGetValue32(FIFO_USER_05) != 0xD2;
 		}
+		bootStage("ramdrive");
 		//if (!(keysHeld() & KEY_X)) {
 			nandMount();
 		//}
+		bootStage("nand");
 		//is3DS = ((access("sd:/Nintendo 3DS", F_OK) == 0) && (*(vu32*)(0x0DFFFE0C) == 0x474D3969));
 		/*FILE* cidFile = fopen("sd:/gm9i/CID.bin", "wb");
 		fwrite((void*)0x2FFD7BC, 1, 16, cidFile);
@@ -177,11 +296,12 @@ int main(int argc, char **argv) {
 		fclose(cidFile);*/
 	} else if (REG_SCFG_EXT != 0) {
 		*(vu32*)(0x0DFFFE0C) = 0x474D3969;		// Check for 32MB of RAM
-		bool ram32MB = *(vu32*)(0x0DFFFE0C) == 0x474D3969;
+		ram32MB = *(vu32*)(0x0DFFFE0C) == 0x474D3969;
 		ramdriveMount(ram32MB);
 		if (ram32MB) {
 			is3DS = fifoGetValue32(FIFO_USER_05) != 0xD2;
 		}
+		bootStage("ramdrive");
 
 		/* FILE* bios = fopen("sd:/_nds/bios9i.bin", "rb");
 		if (!bios) {
@@ -232,14 +352,37 @@ int main(int argc, char **argv) {
 			bios9iEnabled = true; */
 
 			nandMount();
+			bootStage("nand");
 		// }
 	} else if (isRegularDS && (io_dldi_data->ioInterface.features & FEATURE_SLOT_NDS)) {
 		ramdriveMount(false);
+		bootStage("ramdrive");
 	}
+
+	// Only hold the splash for the rest of the 2 seconds if there's a hint
+	// to read, the mounts above usually take most of it anyway
+	if (splashHint) {
+		while (cpuGetTiming() - splashTicks < BUS_CLOCK * 2)
+			swiWaitForVBlank();
+	}
+	if (isDSiMode()) {
+		scanKeys();
+		yHeld = (keysHeld() & KEY_Y);
+	}
+	bootStage("splash");
+
+	font->clear(false);
+	font->print(1, 1, false, titleName);
+	font->print(1, 2, false, "----------------------------------------");
+	font->print(1, 3, false, "https://github.com/DS-Homebrew/GodMode9i");
+	font->print(-2, -2, false, "Mounting drive(s)...", Alignment::right);
+	font->update(false);
+
 	if (!isDSiMode() || !yHeld) {
 		flashcardMounted = flashcardMount();
 		flashcardMountSkipped = false;
 	}
+	bootStage("flashcard");
 
 	// Try to init NitroFS
 	char nandPath[64] = {0};
@@ -265,6 +408,7 @@ int main(int argc, char **argv) {
 		for (int i = 0; i < 30; i++)
 			swiWaitForVBlank();
 	}
+	bootStage("nitrofs");
 
 	// Ensure gm9i folder exists
 	char folderPath[10];
@@ -275,6 +419,22 @@ int main(int argc, char **argv) {
 	// Load config
 	config = new Config();
 
+	// The RAM drive is mounted before the config can be read, it's still
+	// empty here so just remount it if it should be compressed
+	if (ramdriveMounted && config->ramdriveCompressed() && (isDSiMode() || REG_SCFG_EXT != 0)) {
+		ramdriveUnmount();
+		ramdriveMount(ram32MB, true);
+	}
+
+	// NAND is mounted before the config too, its read buffers are only
+	// sized now
+	nandio_set_read_batch(config->nandReadBatch());
+
+	// Bring back the last RAM drive snapshot if asked to
+	if (ramdriveMounted && config->ramdriveRestore() && access(ramdriveSnapshotPath(), F_OK) == 0)
+		ramdriveRestore(ramdriveSnapshotPath());
+	bootStage("config");
+
 	bgHide(bg3);
 
 	// Reinit font, try to load default from SD this time
@@ -288,6 +448,21 @@ int main(int argc, char **argv) {
 
 	// Load translations
 	langInit(false);
+	bootStage("language");
+
+	if ((sdMounted || flashcardMounted) && config->bootProfile()) {
+		char logPath[20];
+		sprintf(logPath, "%s:/gm9i/boot.log", (sdMounted ? "sd" : "fat"));
+		bootProfileSave(logPath);
+	}
+
+	// Record every sector request from here on, the menus flush it
+	if ((sdMounted || flashcardMounted) && config->ioTrace()) {
+		char tracePath[24];
+		sprintf(tracePath, "%s:/gm9i/io_trace.bin", (sdMounted ? "sd" : "fat"));
+		iostats_trace_start(tracePath);
+	}
+	// Timers 2 and 3 keep running for the I/O statistics
 
 	keysSetRepeat(25,5);
 
@@ -3,11 +3,100 @@
 #include <nds/fifocommon.h>
 #include <nds/fifomessages.h>
 #include <nds/system.h>
+#include <nds/bios.h>
 #include <nds/arm9/cache.h>
+#include <nds/memory.h>
 
 volatile bool sdRemoved = false;
 volatile bool sdWriteLocked = false;
 
+// Sector requests go to the ARM7 through a ring in main RAM instead of one
+// blocking FIFO round trip each. The ARM7 works through it from its main
+// loop, so the ARM9 can queue a few and get on with something else.
+// Must match arm7/source/my_sdmmc.c
+#define SDMMC_RING_KICK 0x52494E47 // 'RING'
+
+enum {
+	RING_IDLE = 0,
+	RING_PENDING,
+	RING_DONE
+};
+
+// One cache line each, so either CPU can own a slot without the other's
+// writes to its neighbours getting lost
+typedef struct {
+	vu32 state;
+	u32 type;
+	u32 sector;
+	u32 count;
+	void *buffer;
+	vs32 result;
+	u32 ticket;
+	u32 reserved;
+} SdmmcRingSlot;
+
+static SdmmcRingSlot sdmmcRing[SDMMC_RING_SIZE] __attribute__((aligned(32)));
+static u32 sdmmcNextTicket = 0;
+
+//---------------------------------------------------------------------------------
+u32 my_sdmmc_Submit(u32 type, sec_t sector, sec_t numSectors, void* buffer) {
+//---------------------------------------------------------------------------------
+	u32 ticket = sdmmcNextTicket++;
+	SdmmcRingSlot *slot = &sdmmcRing[ticket % SDMMC_RING_SIZE];
+
+	// The ARM7 may still be on the request that had this slot last time round
+	DC_InvalidateRange(slot, sizeof(SdmmcRingSlot));
+	while (slot->state == RING_PENDING) {
+		swiDelay(64);
+		DC_InvalidateRange(slot, sizeof(SdmmcRingSlot));
+	}
+
+	DC_FlushRange(buffer, numSectors * 512);
+
+	slot->type = type;
+	slot->sector = sector;
+	slot->count = numSectors;
+	slot->buffer = buffer;
+	slot->result = -1;
+	slot->ticket = ticket;
+
+	// A line writeback isn't atomic, so the rest of the slot has to be in RAM
+	// before the ARM7 can see it pending. DC_FlushRange drains the write
+	// buffer too, then state goes straight to RAM.
+	DC_FlushRange(slot, sizeof(SdmmcRingSlot));
+	((SdmmcRingSlot*)memUncached(slot))->state = RING_PENDING;
+
+	// Just to wake the ARM7 up, there's no reply to this
+	FifoMessage msg;
+	msg.type = SDMMC_RING_KICK;
+	msg.sdParams.buffer = sdmmcRing;
+	fifoSendDatamsg(FIFO_SDMMC, sizeof(msg), (u8*)&msg);
+
+	return ticket;
+}
+
+//---------------------------------------------------------------------------------
+bool my_sdmmc_IsDone(u32 ticket) {
+//---------------------------------------------------------------------------------
+	SdmmcRingSlot *slot = &sdmmcRing[ticket % SDMMC_RING_SIZE];
+	DC_InvalidateRange(slot, sizeof(SdmmcRingSlot));
+	return slot->ticket != ticket || slot->state == RING_DONE;
+}
+
+//---------------------------------------------------------------------------------
+bool my_sdmmc_Wait(u32 ticket) {
+//---------------------------------------------------------------------------------
+	SdmmcRingSlot *slot = &sdmmcRing[ticket % SDMMC_RING_SIZE];
+	while (!my_sdmmc_IsDone(ticket))
+		swiDelay(64);
+
+	// Reused by a later request already, the result is gone
+	if (slot->ticket != ticket)
+		return false;
+
+	return slot->result == 0;
+}
+
 void sdStatusHandler(u32 sdIrqStatus, void *userdata) {
 	sdRemoved = (sdIrqStatus & BIT(5)) == 0;
 	sdWriteLocked = (sdIrqStatus & BIT(7)) == 0;
@@ -46,22 +135,7 @@ bool my_sdio_IsInserted() {
 //---------------------------------------------------------------------------------
 bool my_sdio_ReadSectors(sec_t sector, sec_t numSectors,void* buffer) {
 //---------------------------------------------------------------------------------
-	FifoMessage msg;
-
-	DC_FlushRange(buffer,numSectors * 512);
-
-	msg.type = SDMMC_SD_READ_SECTORS;
-	msg.sdParams.startsector = sector;
-	msg.sdParams.numsectors = numSectors;
-	msg.sdParams.buffer = buffer;
-	
-	fifoSendDatamsg(FIFO_SDMMC, sizeof(msg), (u8*)&msg);
-
-	fifoWaitValue32(FIFO_SDMMC);
-
-	int result = fifoGetValue32(FIFO_SDMMC);
-	
-	return result == 0;
+	return my_sdmmc_Wait(my_sdmmc_Submit(SDMMC_SD_READ_SECTORS, sector, numSectors, buffer));
 }
 
 //---------------------------------------------------------------------------------
@@ -70,22 +144,7 @@ bool my_sdio_WriteSectors(sec_t sector, sec_t numSectors,const void* buffer) {
 	if(sdWriteLocked)
 		return false;
 
-	FifoMessage msg;
-
-	DC_FlushRange(buffer,numSectors * 512);
-
-	msg.type = SDMMC_SD_WRITE_SECTORS;
-	msg.sdParams.startsector = sector;
-	msg.sdParams.numsectors = numSectors;
-	msg.sdParams.buffer = (void*)buffer;
-	
-	fifoSendDatamsg(FIFO_SDMMC, sizeof(msg), (u8*)&msg);
-
-	fifoWaitValue32(FIFO_SDMMC);
-
-	int result = fifoGetValue32(FIFO_SDMMC);
-	
-	return result == 0;
+	return my_sdmmc_Wait(my_sdmmc_Submit(SDMMC_SD_WRITE_SECTORS, sector, numSectors, (void*)buffer));
 }
 
 
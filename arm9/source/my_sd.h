@@ -13,6 +13,16 @@ void sdStatusHandler(u32 sdIrqStatus, void *userdata);
 
 bool my_sdio_Shutdown();
 
+#define SDMMC_RING_SIZE 16
+
+// Queue a sector request (SDMMC_SD_READ_SECTORS etc.) for the ARM7 without
+// waiting for it. buffer mustn't be touched until the request is done, and
+// a ticket has to be waited on before SDMMC_RING_SIZE more are submitted or
+// its result is lost.
+u32 my_sdmmc_Submit(u32 type, sec_t sector, sec_t numSectors, void* buffer);
+bool my_sdmmc_IsDone(u32 ticket);
+bool my_sdmmc_Wait(u32 ticket);
+
 const DISC_INTERFACE *__my_io_dsisd();
 
 #ifdef __cplusplus
@@ -9,13 +9,46 @@
 #include "sector0.h"
 #include "tonccpy.h"
 #include "f_xy.h"
+#include "my_sd.h"
 
 //#define SECTOR_SIZE 512
 #define CRYPT_BUF_LEN 64
 
+// Decrypted sector cache, mostly for the FAT and directory sectors libfat
+// keeps coming back to. Bigger reads are file data and skip it entirely.
+// Writes go to the NAND first, the cache never holds anything newer.
+#define NAND_CACHE_MAX_RUN 8
+#define NAND_CACHE_MIN 16
+#define NAND_CACHE_NONE 0xFFFF
+
+typedef struct {
+	sec_t sector;
+	u32 lastUsed;
+	u16 next; // next entry in the same hash bucket
+	bool valid;
+} NandCacheEntry;
+
 static u8* crypt_buf = 0;
 
+// Big reads are double buffered, the ARM7 fills one buffer from the eMMC
+// while the other one is decrypted
+#define READ_BATCH_MIN 16
+#define READ_BATCH_MAX 1024
+
+static u8* read_buf[2] = {0, 0};
+static u32 read_batch = 0; // sectors per buffer, 0 when not allocated
+static u32 read_batch_wanted = 0; // 0 picks by RAM
+
+static NandCacheEntry *cacheEntries = NULL;
+static u16 *cacheBuckets = NULL;
+static u8 *cacheData = NULL;
+static u32 cacheCount = 0;
+static u32 cacheTick = 0;
+static u32 cacheHits = 0;
+static u32 cacheMisses = 0;
+
 static u32 fat_sig_fix_offset = 0;
+static bool cidRequested = false;
 
 static u32 sector_buf32[SECTOR_SIZE/sizeof(u32)];
 static u8 *sector_buf = (u8*)sector_buf32;
@@ -70,25 +103,178 @@ bool my_nand_Startup() {
 	return result == 0;
 }
 
+//---------------------------------------------------------------------------------
+static u32 my_nand_ReadSectorsAsync(sec_t sector, sec_t numSectors,void* buffer) {
+//---------------------------------------------------------------------------------
+	// buffer mustn't be touched until my_nand_ReadSectorsWait(), or stale
+	// lines come back into the cache over what the ARM7 writes
+	return my_sdmmc_Submit(SDMMC_NAND_READ_SECTORS, sector, numSectors, buffer);
+}
+
+//---------------------------------------------------------------------------------
+static bool my_nand_ReadSectorsWait(u32 ticket) {
+//---------------------------------------------------------------------------------
+	return my_sdmmc_Wait(ticket);
+}
+
 //---------------------------------------------------------------------------------
 bool my_nand_ReadSectors(sec_t sector, sec_t numSectors,void* buffer) {
 //---------------------------------------------------------------------------------
-	FifoMessage msg;
+	return my_nand_ReadSectorsWait(my_nand_ReadSectorsAsync(sector, numSectors, buffer));
+}
 
-	DC_FlushRange(buffer,numSectors * 512);
+static void nand_cache_free(void) {
+	free(cacheEntries);
+	free(cacheBuckets);
+	free(cacheData);
+	cacheEntries = NULL;
+	cacheBuckets = NULL;
+	cacheData = NULL;
+	cacheCount = 0;
+	cacheTick = 0;
+}
 
-	msg.type = SDMMC_NAND_READ_SECTORS;
-	msg.sdParams.startsector = sector;
-	msg.sdParams.numsectors = numSectors;
-	msg.sdParams.buffer = buffer;
-	
-	fifoSendDatamsg(FIFO_SDMMC, sizeof(msg), (u8*)&msg);
+static void nand_cache_alloc(void) {
+	nand_cache_free();
+
+	// Size the cache by how much RAM there is, backing off if the heap is
+	// already busy. The count stays a power of two for the bucket mask.
+	u32 count = isDSiMode() ? 1024 : 128;
+	for (; count >= NAND_CACHE_MIN; count /= 2) {
+		cacheEntries = (NandCacheEntry*)calloc(count, sizeof(NandCacheEntry));
+		cacheBuckets = (u16*)malloc(count * sizeof(u16));
+		cacheData = (u8*)malloc(count * SECTOR_SIZE);
+		if (cacheEntries && cacheBuckets && cacheData)
+			break;
+		nand_cache_free();
+	}
 
-	fifoWaitValue32(FIFO_SDMMC);
+	if (count < NAND_CACHE_MIN)
+		return;
 
-	int result = fifoGetValue32(FIFO_SDMMC);
-	
-	return result == 0;
+	cacheCount = count;
+	for (u32 i = 0; i < cacheCount; i++)
+		cacheBuckets[i] = NAND_CACHE_NONE;
+}
+
+static int nand_cache_find(sec_t sector) {
+	for (u16 i = cacheBuckets[sector & (cacheCount - 1)]; i != NAND_CACHE_NONE; i = cacheEntries[i].next) {
+		if (cacheEntries[i].sector == sector)
+			return i;
+	}
+
+	return -1;
+}
+
+static void nand_cache_unlink(u32 index) {
+	u16 *link = &cacheBuckets[cacheEntries[index].sector & (cacheCount - 1)];
+	while (*link != index)
+		link = &cacheEntries[*link].next;
+	*link = cacheEntries[index].next;
+	cacheEntries[index].valid = false;
+}
+
+static void nand_cache_insert(sec_t sector, const void *buffer) {
+	int index = nand_cache_find(sector);
+
+	if (index < 0) {
+		// Take a free slot if there is one, otherwise the least recently used
+		index = 0;
+		for (u32 i = 0; i < cacheCount; i++) {
+			if (!cacheEntries[i].valid) {
+				index = i;
+				break;
+			}
+			if (cacheEntries[i].lastUsed < cacheEntries[index].lastUsed)
+				index = i;
+		}
+
+		if (cacheEntries[index].valid)
+			nand_cache_unlink(index);
+
+		u16 *bucket = &cacheBuckets[sector & (cacheCount - 1)];
+		cacheEntries[index].sector = sector;
+		cacheEntries[index].next = *bucket;
+		cacheEntries[index].valid = true;
+		*bucket = index;
+	}
+
+	tonccpy(cacheData + index * SECTOR_SIZE, buffer, SECTOR_SIZE);
+	cacheEntries[index].lastUsed = ++cacheTick;
+}
+
+static void nand_cache_drop(sec_t start, sec_t len) {
+	for (sec_t i = 0; i < len; i++) {
+		int index = nand_cache_find(start + i);
+		if (index >= 0)
+			nand_cache_unlink(index);
+	}
+}
+
+// Keep cached copies in step with what was just written, small writes are
+// usually the FAT and directories so those get added as well
+static void nand_cache_written(sec_t start, sec_t len, const void *buffer, bool success) {
+	if (!success) {
+		// Whatever is on the NAND now, it can't be trusted to match
+		nand_cache_drop(start, len);
+		return;
+	}
+
+	for (sec_t i = 0; i < len; i++) {
+		if (len <= NAND_CACHE_MAX_RUN || nand_cache_find(start + i) >= 0)
+			nand_cache_insert(start + i, (const u8*)buffer + i * SECTOR_SIZE);
+	}
+}
+
+static void read_buf_free(void) {
+	free(read_buf[0]);
+	free(read_buf[1]);
+	read_buf[0] = 0;
+	read_buf[1] = 0;
+	read_batch = 0;
+}
+
+static void read_buf_alloc(void) {
+	read_buf_free();
+
+	u32 batch = read_batch_wanted;
+	if (batch == 0)
+		batch = isDSiMode() ? 256 : CRYPT_BUF_LEN;
+	if (batch < READ_BATCH_MIN)
+		batch = READ_BATCH_MIN;
+	if (batch > READ_BATCH_MAX)
+		batch = READ_BATCH_MAX;
+
+	// Back off if the heap is busy, reads go through crypt_buf without these
+	for (; batch >= READ_BATCH_MIN; batch /= 2) {
+		read_buf[0] = (u8*)memalign(32, batch * SECTOR_SIZE);
+		read_buf[1] = (u8*)memalign(32, batch * SECTOR_SIZE);
+		if (read_buf[0] && read_buf[1]) {
+			read_batch = batch;
+			return;
+		}
+		read_buf_free();
+	}
+}
+
+void nandio_set_read_batch(u32 sectors) {
+	read_batch_wanted = sectors;
+	if (crypt_buf)
+		read_buf_alloc();
+}
+
+void nandio_cache_stats(u32 *hits, u32 *misses) {
+	*hits = cacheHits;
+	*misses = cacheMisses;
+}
+
+void nandio_request_cid() {
+	if (!isDSiMode() || *(vu32*)(0xCFFD7BC) != 0) return;
+
+	// Have the ARM7 start the eMMC and read its CID while the SD card mounts,
+	// nandio_startup() picks it up
+	*(vu32*)(0xCFFFD0C) = 0x454D4D43;
+	cidRequested = true;
 }
 
 bool nandio_startup() {
@@ -98,7 +284,18 @@ bool nandio_startup() {
 	bool isDSi = parse_ncsd(sector_buf, 0) != 0;
 	//if (!isDSi) return false;
 
-	if (*(u32*)(0x2FFD7BC) == 0) {
+	bool cidEarly = cidRequested;
+	if (cidRequested) {
+		while (*(vu32*)(0xCFFFD0C) != 0) {
+			swiDelay(100);
+		}
+		// Through the uncached mirror so no stale cache line hides it
+		tonccpy((void*)0x2FFD7BC, (void*)0xCFFD7BC, 16);
+		cidRequested = false;
+	}
+
+	// On a 3DS the eMMC CID is the wrong one, that comes from a file
+	if (*(u32*)(0x2FFD7BC) == 0 || (cidEarly && !isDSi)) {
 		if (!isDSi) {
 			FILE* cidFile = fopen("sd:/gm9/out/nand_cid.mem", "rb");
 			if (!cidFile) return false;
@@ -136,6 +333,12 @@ bool nandio_startup() {
 			//printf("nandio: failed to alloc buffer\n");
 		//}
 	}
+
+	cacheHits = 0;
+	cacheMisses = 0;
+	nand_cache_alloc();
+	read_buf_alloc();
+
 	return crypt_buf != 0;
 }
 
@@ -143,20 +346,25 @@ bool nandio_is_inserted() {
 	return true;
 }
 
+// src is aligned for the ARM7, so decrypt there and copy out
+static bool decrypt_sectors(sec_t start, sec_t len, u8 *src, void *buffer) {
+	int hw = dsi_nand_crypt_hw(src, start * SECTOR_SIZE / AES_BLOCK_SIZE, len * SECTOR_SIZE / AES_BLOCK_SIZE);
+	if (hw > 0) {
+		tonccpy(buffer, src, len * SECTOR_SIZE);
+		return true;
+	}
+
+	// The engine gave up part way through src, so read it again
+	if (hw < 0 && !my_nand_ReadSectors(start, len, src))
+		return false;
+
+	dsi_nand_crypt(buffer, src, start * SECTOR_SIZE / AES_BLOCK_SIZE, len * SECTOR_SIZE / AES_BLOCK_SIZE);
+	return true;
+}
+
 // len is guaranteed <= CRYPT_BUF_LEN
 static bool read_sectors(sec_t start, sec_t len, void *buffer) {
-	if (my_nand_ReadSectors(start, len, crypt_buf)) {
-		dsi_nand_crypt(buffer, crypt_buf, start * SECTOR_SIZE / AES_BLOCK_SIZE, len * SECTOR_SIZE / AES_BLOCK_SIZE);
-		if (fat_sig_fix_offset &&
-			start == fat_sig_fix_offset
-			&& ((u8*)buffer)[0x36] == 0
-			&& ((u8*)buffer)[0x37] == 0
-			&& ((u8*)buffer)[0x38] == 0)
-		{
-			((u8*)buffer)[0x36] = 'F';
-			((u8*)buffer)[0x37] = 'A';
-			((u8*)buffer)[0x38] = 'T';
-		}
+	if (my_nand_ReadSectors(start, len, crypt_buf) && decrypt_sectors(start, len, crypt_buf, buffer)) {
 		return true;
 	} else {
 		//printf("NANDIO: read error\n");
@@ -164,28 +372,129 @@ static bool read_sectors(sec_t start, sec_t len, void *buffer) {
 	}
 }
 
+// The next batch is always requested before the current one is decrypted,
+// so the eMMC transfer and the AES overlap
+static bool read_sectors_pipelined(sec_t start, sec_t len, u8 *buffer) {
+	// Split reads under two batches in half, otherwise nothing overlaps
+	sec_t step = len < read_batch * 2 ? (len + 1) / 2 : read_batch;
+	sec_t batch = step;
+	int current = 0;
+
+	u32 ticket = my_nand_ReadSectorsAsync(start, batch, read_buf[current]);
+	while (len > 0) {
+		if (!my_nand_ReadSectorsWait(ticket)) {
+			//printf("NANDIO: read error\n");
+			return false;
+		}
+
+		sec_t remaining = len - batch;
+		sec_t next = remaining < step ? remaining : step;
+		if (next > 0)
+			ticket = my_nand_ReadSectorsAsync(start + batch, next, read_buf[current ^ 1]);
+
+		if (!decrypt_sectors(start, batch, read_buf[current], buffer)) {
+			// Don't leave the next read writing into a buffer after return
+			if (next > 0)
+				my_nand_ReadSectorsWait(ticket);
+			return false;
+		}
+
+		start += batch;
+		buffer += batch * SECTOR_SIZE;
+		len -= batch;
+		batch = next;
+		current ^= 1;
+	}
+
+	return true;
+}
+
+static bool read_sectors_cached(sec_t start, sec_t len, u8 *buffer) {
+	while (len > 0) {
+		int index = nand_cache_find(start);
+		if (index >= 0) {
+			tonccpy(buffer, cacheData + index * SECTOR_SIZE, SECTOR_SIZE);
+			cacheEntries[index].lastUsed = ++cacheTick;
+			cacheHits++;
+			start++;
+			buffer += SECTOR_SIZE;
+			len--;
+			continue;
+		}
+
+		// Read the whole run of uncached sectors in one go
+		sec_t run = 1;
+		while (run < len && nand_cache_find(start + run) < 0)
+			run++;
+
+		if (!read_sectors(start, run, buffer))
+			return false;
+
+		cacheMisses += run;
+		for (sec_t i = 0; i < run; i++)
+			nand_cache_insert(start + i, buffer + i * SECTOR_SIZE);
+
+		start += run;
+		buffer += run * SECTOR_SIZE;
+		len -= run;
+	}
+
+	return true;
+}
+
 bool nandio_read_sectors(sec_t offset, sec_t len, void *buffer) {
 	// iprintf("R: %u(0x%08x), %u\n", (unsigned)offset, (unsigned)offset, (unsigned)len);
-	while (len >= CRYPT_BUF_LEN) {
-		if (!read_sectors(offset, CRYPT_BUF_LEN, buffer)) {
+	sec_t start = offset, count = len;
+	u8 *out = (u8*)buffer;
+
+	if (cacheCount > 0 && len <= NAND_CACHE_MAX_RUN) {
+		if (!read_sectors_cached(offset, len, buffer)) {
+			return false;
+		}
+	} else if (read_batch > 0 && len > CRYPT_BUF_LEN) {
+		if (!read_sectors_pipelined(offset, len, buffer)) {
 			return false;
 		}
-		offset += CRYPT_BUF_LEN;
-		len -= CRYPT_BUF_LEN;
-		buffer = ((u8*)buffer) + SECTOR_SIZE * CRYPT_BUF_LEN;
-	}
-	if (len > 0) {
-		return read_sectors(offset, len, buffer);
 	} else {
-		return true;
+		while (len >= CRYPT_BUF_LEN) {
+			if (!read_sectors(offset, CRYPT_BUF_LEN, buffer)) {
+				return false;
+			}
+			offset += CRYPT_BUF_LEN;
+			len -= CRYPT_BUF_LEN;
+			buffer = ((u8*)buffer) + SECTOR_SIZE * CRYPT_BUF_LEN;
+		}
+		if (len > 0 && !read_sectors(offset, len, buffer)) {
+			return false;
+		}
+	}
+
+	// Patched on the way out rather than in the cache, so it never gets
+	// mistaken for what's actually on the NAND
+	if (fat_sig_fix_offset
+		&& start <= fat_sig_fix_offset
+		&& fat_sig_fix_offset - start < count)
+	{
+		u8 *bootSector = out + (fat_sig_fix_offset - start) * SECTOR_SIZE;
+		if (bootSector[0x36] == 0 && bootSector[0x37] == 0 && bootSector[0x38] == 0) {
+			bootSector[0x36] = 'F';
+			bootSector[0x37] = 'A';
+			bootSector[0x38] = 'T';
+		}
 	}
+	return true;
 }
 
 static bool write_sectors(sec_t start, sec_t len, const void *buffer) {
-	dsi_nand_crypt(crypt_buf, buffer, start * SECTOR_SIZE / AES_BLOCK_SIZE, len * SECTOR_SIZE / AES_BLOCK_SIZE);
+	tonccpy(crypt_buf, buffer, len * SECTOR_SIZE);
+	if (dsi_nand_crypt_hw(crypt_buf, start * SECTOR_SIZE / AES_BLOCK_SIZE, len * SECTOR_SIZE / AES_BLOCK_SIZE) <= 0)
+		dsi_nand_crypt(crypt_buf, buffer, start * SECTOR_SIZE / AES_BLOCK_SIZE, len * SECTOR_SIZE / AES_BLOCK_SIZE);
 	// if (fseek(f, start * SECTOR_SIZE, SEEK_SET) != 0) {
 	// if (fwrite(crypt_buf, SECTOR_SIZE, len, f) == len) {
-	if(nand_WriteSectors(start, len, crypt_buf)){
+	bool success = nand_WriteSectors(start, len, crypt_buf);
+	if (cacheCount > 0)
+		nand_cache_written(start, len, buffer, success);
+	if(success){
 		return true;
 	} else {
 		//printf("NANDIO: write error\n");
@@ -211,6 +520,38 @@ bool nandio_write_sectors(sec_t offset, sec_t len, const void *buffer) {
 	}
 }
 
+u32 nandio_get_size(void) {
+	fifoSendValue32(FIFO_SDMMC, SDMMC_NAND_SIZE);
+	fifoWaitValue32(FIFO_SDMMC);
+	return fifoGetValue32(FIFO_SDMMC);
+}
+
+void nandio_get_ids(u8 *cid, u8 *consoleID) {
+	tonccpy(cid, (u8*)0x2FFD7BC, 16);
+	getConsoleID(consoleID);
+}
+
+bool nandio_read_raw_sectors(sec_t offset, sec_t len, void *buffer) {
+	return my_nand_ReadSectors(offset, len, buffer);
+}
+
+bool nandio_write_raw_sectors(sec_t offset, sec_t len, const void *buffer) {
+	bool success = nand_WriteSectors(offset, len, buffer);
+	// The decrypted copies are stale either way
+	if (cacheCount > 0)
+		nand_cache_drop(offset, len);
+	return success;
+}
+
+bool nandio_raw_image_matches(const void *sector0) {
+	if (crypt_buf == 0)
+		return false;
+
+	// An image from another console won't decrypt to a valid MBR
+	dsi_nand_crypt(sector_buf, sector0, 0, SECTOR_SIZE / AES_BLOCK_SIZE);
+	return sector_buf[0x1FE] == 0x55 && sector_buf[0x1FF] == 0xAA;
+}
+
 bool nandio_clear_status() {
 	return true;
 }
@@ -218,6 +559,8 @@ bool nandio_clear_status() {
 bool nandio_shutdown() {
 	free(crypt_buf);
 	crypt_buf = 0;
+	nand_cache_free();
+	read_buf_free();
 	return true;
 }
 
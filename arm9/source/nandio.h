@@ -3,6 +3,33 @@
 #include <nds.h>
 #include <nds/disc_io.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 void nandio_set_fat_sig_fix(u32 offset);
 
+// Starts fetching the eMMC CID on the ARM7 so it's ready by the NAND mount
+void nandio_request_cid(void);
+
+// Sectors per request for big reads, 0 picks by how much RAM there is
+void nandio_set_read_batch(u32 sectors);
+
+// Raw (still encrypted) access for whole NAND backups, sizes in sectors
+u32 nandio_get_size(void);
+void nandio_get_ids(u8 *cid, u8 *consoleID);
+bool nandio_read_raw_sectors(sec_t offset, sec_t len, void *buffer);
+bool nandio_write_raw_sectors(sec_t offset, sec_t len, const void *buffer);
+
+// Whether a raw sector 0 decrypts with this console's NAND key,
+// only valid while the NAND is mounted
+bool nandio_raw_image_matches(const void *sector0);
+
+// Sectors served from / missed in the decrypted sector cache since mount
+void nandio_cache_stats(u32 *hits, u32 *misses);
+
+#ifdef __cplusplus
+}
+#endif
+
 extern const DISC_INTERFACE io_dsi_nand;
@@ -48,12 +48,26 @@
     2018-09-05 v0.9 - modernize devoptab (by RonnChyran)
         * Updated for libsysbase change in devkitARM r46 and above. 
 
+    2026-10-19 v0.10 - in-memory index
+        * nitroFSInit() now loads the FNT and FAT into RAM once and builds a hash of
+          (parent dir, name) -> entry, so open/stat/diropen/chdir resolve a path with
+          one lookup per component and directory listings no longer touch the image.
+        * reads from the .nds file go through a sector aligned read-ahead window that
+          grows while reads are sequential, reads bigger than the window skip it.
+        * nitroFSExtract() copies a whole directory tree out in rom offset order, so
+          the image is read front to back instead of in filename order.
+        * nitroFSInitCard() mounts straight from the slot-1 card through cardRead(),
+          only the blocks that get browsed or read are fetched from the card.
+
 */
 
 #include <string.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <nds.h>
+#include <sys/stat.h>
 #include "nitrofs.h"
+#include "read_card.h"
 #include "tonccpy.h"
 
 //This seems to be a typo! memory.h has REG_EXEMEMCNT
@@ -63,6 +77,10 @@
 
 #define __itcm __attribute__((section(".itcm")))
 
+#define NITROSECTORSIZE 0x200
+#define NITROCACHEMIN 0x1000  //read-ahead window after a seek
+#define NITROCACHEMAX 0x10000 //read-ahead window once reads are sequential
+
 //Globals!
 u32 fntOffset;   //offset to start of filename table
 u32 fatOffset;   //offset to start of file alloc table
@@ -70,6 +88,32 @@ bool hasLoader;  //single global nds filehandle (is null if not in dldi/fat mode
 u16 chdirpathid; //default dir path id...
 FILE *ndsFile = NULL;
 off_t ndsFileLastpos; //Used to determine need to fseek or not
+bool nitroFromCard = false; //reading from the slot-1 card instead of ndsFile
+
+//Read-ahead window over ndsFile
+static u8 *nitroCache = NULL;
+static off_t nitroCacheStart = 0; //image offset of nitroCache[0], always sector aligned
+static size_t nitroCacheLen = 0;  //valid bytes in nitroCache
+static size_t nitroCacheSize = NITROCACHEMIN;
+static off_t nitroLastReadEnd = -1;
+
+//In-RAM copies of the filename and file allocation tables, loaded once by nitroFSInit()
+static u8 *fntData = NULL;
+static u32 fntSize = 0;
+static struct ROM_FAT *fatData = NULL;
+static u32 fatCount = 0;
+
+//One entry per file or directory name in the FNT
+struct nitroIndexEntry
+{
+    u32 nameOffset; //offset in fntData of the entry's length byte
+    u16 parent_id;  //directory this entry is in
+    u16 id;         //file id, or directory id (0xf000 based) if it's a directory
+};
+
+static struct nitroIndexEntry *indexEntries = NULL;
+static u32 *indexBuckets = NULL; //index into indexEntries + 1, 0 = empty slot
+static u32 indexMask = 0;
 
 devoptab_t nitroFSdevoptab = {
     "nitro",                       //	const char *name;
@@ -100,14 +144,98 @@ devoptab_t nitroFSdevoptab = {
 //so, instead we have this weird weird haxy try gbaslot then try dldi method. If i (or you!!) ever do figure out
 //how to read the proper way can replace these 4 functions and everything should work normally :)
 
+//reads from the slot-1 card, cardRead() only does whole aligned blocks
+//so unaligned ends or buffers bounce through a block buffer
+static size_t nitroCardRead(off_t pos, u8 *ptr, size_t len)
+{
+    static u32 block[CARD_DATA_BLOCK_SIZE / sizeof(u32)];
+    size_t done = 0;
+    while (done < len)
+    {
+        u32 src = pos + done;
+        u32 offset = src & (CARD_DATA_BLOCK_SIZE - 1);
+        size_t n = CARD_DATA_BLOCK_SIZE - offset;
+        if (n > len - done)
+            n = len - done;
+        if (n == CARD_DATA_BLOCK_SIZE && ((u32)(ptr + done) & 3) == 0)
+        {
+            cardRead(src, ptr + done, false);
+        }
+        else
+        {
+            cardRead(src - offset, block, false);
+            tonccpy(ptr + done, (u8 *)block + offset, n);
+        }
+        done += n;
+    }
+    return (done);
+}
+
+//reads straight from ndsFile (or the card), only seeking if the last read didnt end here
+static size_t nitroFileRead(off_t pos, void *ptr, size_t len)
+{
+    if (nitroFromCard)
+        return (nitroCardRead(pos, ptr, len));
+    if (ndsFileLastpos != pos)
+        fseek(ndsFile, pos, SEEK_SET); //if we need to, move! (might want to verify this succeed)
+    len = fread(ptr, 1, len, ndsFile);
+    ndsFileLastpos = pos + len; //save the current file nds pos
+    return (len);
+}
+
+//reads from ndsFile through the read-ahead window
+//the window doubles on every read that continues the last one and drops back after a seek,
+//so small sequential reads turn into big sector aligned ones while random access stays cheap
+static size_t nitroCachedRead(off_t pos, u8 *ptr, size_t len)
+{
+    size_t done = 0;
+
+    if (pos == nitroLastReadEnd)
+    {
+        if (nitroCacheSize < NITROCACHEMAX)
+            nitroCacheSize <<= 1;
+    }
+    else
+    {
+        nitroCacheSize = NITROCACHEMIN;
+    }
+    nitroLastReadEnd = pos + len;
+
+    while (done < len)
+    {
+        off_t cur = pos + done;
+        size_t remaining = len - done;
+        if (nitroCache && cur >= nitroCacheStart && cur < nitroCacheStart + (off_t)nitroCacheLen)
+        { //hit, copy what we have
+            size_t n = nitroCacheStart + nitroCacheLen - cur;
+            if (n > remaining)
+                n = remaining;
+            tonccpy(ptr + done, nitroCache + (cur - nitroCacheStart), n);
+            done += n;
+        }
+        else if (!nitroCache || remaining >= nitroCacheSize)
+        { //big read, dont bother copying it through the window
+            done += nitroFileRead(cur, ptr + done, remaining);
+            break;
+        }
+        else
+        { //refill the window from the sector containing cur
+            nitroCacheStart = cur & ~(off_t)(NITROSECTORSIZE - 1);
+            nitroCacheLen = nitroFileRead(nitroCacheStart, nitroCache, nitroCacheSize);
+            if (nitroCacheStart + (off_t)nitroCacheLen <= cur)
+                break; //eof
+        }
+    }
+
+    return (done);
+}
+
 //reads from rom image either gba rom or dldi
 static inline ssize_t nitroSubRead(off_t *npos, void *ptr, size_t len)
 {
-    if (ndsFile != NULL)
-    { //read from ndsfile
-        if (ndsFileLastpos != *npos)
-            fseek(ndsFile, *npos, SEEK_SET); //if we need to, move! (might want to verify this succeed)
-        len = fread(ptr, 1, len, ndsFile);
+    if (ndsFile != NULL || nitroFromCard)
+    { //read from ndsfile or card
+        len = nitroCachedRead(*npos, ptr, len);
     }
     else
     {                                             //reading from gbarom
@@ -115,7 +243,6 @@ static inline ssize_t nitroSubRead(off_t *npos, void *ptr, size_t len)
     }
     if (len > 0)
         *npos += len;
-    ndsFileLastpos = *npos; //save the current file nds pos
     return (len);
 }
 
@@ -128,105 +255,287 @@ static inline void nitroSubSeek(off_t *npos, int pos, int dir)
         *npos += pos; //see ez!
 }
 
-//Figure out if its gba or ds, setup stuff
-int __itcm
-nitroFSInit(const char *ndsfile)
+static inline u16 nitroRead16(const u8 *ptr)
+{
+    return ptr[0] | (ptr[1] << 8); //name table entries arent aligned
+}
+
+static void nitroIndexFree(void)
+{
+    free(indexBuckets);
+    free(indexEntries);
+    free(fatData);
+    free(fntData);
+    indexBuckets = NULL;
+    indexEntries = NULL;
+    fatData = NULL;
+    fntData = NULL;
+    fntSize = 0;
+    fatCount = 0;
+    indexMask = 0;
+}
+
+//FNV-1a over the parent id and name
+static u32 nitroHash(u16 parent_id, const char *name, size_t len)
+{
+    u32 hash = 2166136261u;
+    hash = (hash ^ (parent_id & 0xff)) * 16777619u;
+    hash = (hash ^ (parent_id >> 8)) * 16777619u;
+    while (len--)
+        hash = (hash ^ (u8)*name++) * 16777619u;
+    return hash;
+}
+
+//number of directories, the root's parent_id field holds it
+static inline u16 nitroDirCount(void)
+{
+    return ((struct ROM_FNTDir *)fntData)->parent_id;
+}
+
+//walks every directory's name list, calling back with each entry. returns false if the FNT is malformed
+static bool nitroIndexWalk(u32 *count, bool fill)
+{
+    struct ROM_FNTDir *dirs = (struct ROM_FNTDir *)fntData;
+    u16 dirCount = nitroDirCount();
+    u32 n = 0;
+
+    if (dirCount == 0 || dirCount > (NITRODIRMASK + 1) || dirCount * sizeof(struct ROM_FNTDir) > fntSize)
+        return false;
+
+    for (u16 dir = 0; dir < dirCount; dir++)
+    {
+        u32 namepos = dirs[dir].entry_start;
+        u16 file_id = dirs[dir].entry_file_id;
+        u8 next;
+        while (namepos < fntSize && (next = fntData[namepos]) != 0)
+        {
+            u8 len = next & (NITROISDIR ^ 0xff);
+            u32 entrySize = 1 + len + ((next & NITROISDIR) ? sizeof(u16) : 0);
+            if (namepos + entrySize > fntSize)
+                return false;
+            if (fill)
+            {
+                struct nitroIndexEntry *entry = &indexEntries[n];
+                entry->nameOffset = namepos;
+                entry->parent_id = NITROROOT | dir;
+                entry->id = (next & NITROISDIR) ? nitroRead16(fntData + namepos + 1 + len) : file_id;
+
+                u32 slot = nitroHash(entry->parent_id, (const char *)fntData + namepos + 1, len) & indexMask;
+                while (indexBuckets[slot])
+                    slot = (slot + 1) & indexMask; //linear probing, table is kept under half full
+                indexBuckets[slot] = n + 1;
+            }
+            if (!(next & NITROISDIR))
+                file_id++;
+            namepos += entrySize;
+            n++;
+        }
+    }
+
+    *count = n;
+    return true;
+}
+
+//loads the FNT and FAT from the image and hashes every name in it
+static bool nitroIndexBuild(u32 fntLen, u32 fatLen)
+{
+    off_t pos;
+    u32 count;
+
+    if (fntLen < sizeof(struct ROM_FNTDir))
+        return false;
+
+    fntData = (u8 *)malloc(fntLen);
+    fatData = (struct ROM_FAT *)malloc(fatLen ? fatLen : sizeof(struct ROM_FAT));
+    if (!fntData || !fatData)
+        return false;
+    fntSize = fntLen;
+    fatCount = fatLen / sizeof(struct ROM_FAT);
+
+    pos = fntOffset;
+    if (nitroSubRead(&pos, fntData, fntLen) != (ssize_t)fntLen)
+        return false;
+    pos = fatOffset;
+    if (nitroSubRead(&pos, fatData, fatLen) != (ssize_t)fatLen)
+        return false;
+
+    //count first so the tables can be allocated in one go
+    if (!nitroIndexWalk(&count, false))
+        return false;
+
+    u32 buckets = 16;
+    while (buckets < count * 2)
+        buckets <<= 1;
+    indexEntries = (struct nitroIndexEntry *)malloc((count ? count : 1) * sizeof(struct nitroIndexEntry));
+    indexBuckets = (u32 *)calloc(buckets, sizeof(u32));
+    if (!indexEntries || !indexBuckets)
+        return false;
+    indexMask = buckets - 1;
+
+    return nitroIndexWalk(&count, true);
+}
+
+//finds name in directory parent_id, returns the index entry or NULL
+static struct nitroIndexEntry *nitroIndexFind(u16 parent_id, const char *name, size_t len)
+{
+    u32 slot = nitroHash(parent_id, name, len) & indexMask;
+    u32 entryNum;
+    while ((entryNum = indexBuckets[slot]) != 0)
+    {
+        struct nitroIndexEntry *entry = &indexEntries[entryNum - 1];
+        const u8 *entryName = fntData + entry->nameOffset;
+        if (entry->parent_id == parent_id && (*entryName & (NITROISDIR ^ 0xff)) == len && memcmp(entryName + 1, name, len) == 0)
+            return entry;
+        slot = (slot + 1) & indexMask;
+    }
+    return NULL;
+}
+
+//resolves path (absolute or relative to chdirpathid) to a file id or a 0xf000 based dir id
+static bool nitroResolvePath(const char *path, u16 *id)
+{
+    const char *cptr;
+    u16 cur;
+    if ((cptr = strchr(path, ':')))
+        path = cptr + 1; //move path past any device names
+    cur = (*path == '/') ? NITROROOT : chdirpathid;
+    while (*path)
+    {
+        size_t len;
+        while (*path == '/')
+            path++; //move past any leading / or // together
+        if (*path == 0)
+            break;
+        cptr = strchr(path, '/');
+        len = cptr ? (size_t)(cptr - path) : strlen(path);
+        if (cur < NITROROOT)
+            return false; //files dont have children
+        if (len == 1 && path[0] == '.')
+        {
+            //stay here
+        }
+        else if (len == 2 && path[0] == '.' && path[1] == '.')
+        {
+            if (cur != NITROROOT)
+                cur = ((struct ROM_FNTDir *)fntData)[cur & NITRODIRMASK].parent_id;
+        }
+        else
+        {
+            struct nitroIndexEntry *entry = nitroIndexFind(cur, path, len);
+            if (!entry)
+                return false;
+            cur = entry->id;
+        }
+        path += len;
+    }
+    *id = cur;
+    return true;
+}
+
+static inline bool nitroIsDir(u16 id)
+{
+    return id >= NITROROOT && (id & NITRODIRMASK) < nitroDirCount();
+}
+
+//reads the header and tables of whatever nitroSubRead() is pointed at, and adds the device
+static int nitroFSMount(void)
 {
     off_t pos = 0;
     char romstr[0x10];
+    u32 fntLen = 0, fatLen = 0;
+    nitroSubRead(&pos, romstr, strlen(LOADERSTR));
+    if (strncmp(romstr, LOADERSTR, strlen(LOADERSTR)) == 0)
+    {
+        nitroSubSeek(&pos, LOADEROFFSET + FNTOFFSET, SEEK_SET);
+        nitroSubRead(&pos, &fntOffset, sizeof(fntOffset));
+        nitroSubSeek(&pos, LOADEROFFSET + FNTSIZEOFFSET, SEEK_SET);
+        nitroSubRead(&pos, &fntLen, sizeof(fntLen));
+        nitroSubSeek(&pos, LOADEROFFSET + FATOFFSET, SEEK_SET);
+        nitroSubRead(&pos, &fatOffset, sizeof(fatOffset));
+        nitroSubSeek(&pos, LOADEROFFSET + FATSIZEOFFSET, SEEK_SET);
+        nitroSubRead(&pos, &fatLen, sizeof(fatLen));
+        fatOffset += LOADEROFFSET;
+        fntOffset += LOADEROFFSET;
+        hasLoader = true;
+    }
+    else
+    {
+        nitroSubSeek(&pos, FNTOFFSET, SEEK_SET);
+        nitroSubRead(&pos, &fntOffset, sizeof(fntOffset));
+        nitroSubSeek(&pos, FNTSIZEOFFSET, SEEK_SET);
+        nitroSubRead(&pos, &fntLen, sizeof(fntLen));
+        nitroSubSeek(&pos, FATOFFSET, SEEK_SET);
+        nitroSubRead(&pos, &fatOffset, sizeof(fatOffset));
+        nitroSubSeek(&pos, FATSIZEOFFSET, SEEK_SET);
+        nitroSubRead(&pos, &fatLen, sizeof(fatLen));
+        hasLoader = false;
+    }
+    if (fntOffset == 0 || fatOffset == 0 || !nitroIndexBuild(fntLen, fatLen))
+    {
+        nitroIndexFree();
+        return (0);
+    }
+    else
+    {
+        AddDevice(&nitroFSdevoptab);
+        return (1);
+    }
+}
+
+//forget the old image, if any
+static void nitroFSReset(void)
+{
     chdirpathid = NITROROOT;
     ndsFileLastpos = 0;
+    nitroIndexFree();
+    nitroCacheLen = 0;
+    nitroLastReadEnd = -1;
+    nitroFromCard = false;
     if(ndsFile != NULL) {
         fclose(ndsFile);
         ndsFile = NULL;
     }
+    if (!nitroCache)
+        nitroCache = (u8 *)malloc(NITROCACHEMAX); //without it reads just go straight to the file
+}
+
+//Figure out if its gba or ds, setup stuff
+int __itcm
+nitroFSInit(const char *ndsfile)
+{
+    nitroFSReset();
     if (ndsfile != NULL)
     {
         if ((ndsFile = fopen(ndsfile, "rb")))
         {
-            nitroSubRead(&pos, romstr, strlen(LOADERSTR));
-            if (strncmp(romstr, LOADERSTR, strlen(LOADERSTR)) == 0)
-            {
-                nitroSubSeek(&pos, LOADEROFFSET + FNTOFFSET, SEEK_SET);
-                nitroSubRead(&pos, &fntOffset, sizeof(fntOffset));
-                nitroSubSeek(&pos, LOADEROFFSET + FATOFFSET, SEEK_SET);
-                nitroSubRead(&pos, &fatOffset, sizeof(fatOffset));
-                fatOffset += LOADEROFFSET;
-                fntOffset += LOADEROFFSET;
-                hasLoader = true;
-            }
-            else
-            {
-                nitroSubSeek(&pos, FNTOFFSET, SEEK_SET);
-                nitroSubRead(&pos, &fntOffset, sizeof(fntOffset));
-                nitroSubSeek(&pos, FATOFFSET, SEEK_SET);
-                nitroSubRead(&pos, &fatOffset, sizeof(fatOffset));
-                hasLoader = false;
-            }
             setvbuf(ndsFile, NULL, _IONBF, 0); //we dont need double buffs u_u
-			if (fntOffset==0 || fatOffset==0)
-			{
-				return (0);
-			}
-			else
-			{
-				AddDevice(&nitroFSdevoptab);
-				return (1);
-			}
+            return (nitroFSMount());
         }
     }
     return (0);
 }
 
+//Mount the inserted slot-1 card, cardInit() must have been called already
+int nitroFSInitCard(void)
+{
+    int ret;
+    nitroFSReset();
+    nitroFromCard = true;
+    if (!(ret = nitroFSMount()))
+        nitroFromCard = false;
+    return (ret);
+}
+
 //Directory functs
 DIR_ITER *nitroFSDirOpen(struct _reent *r, DIR_ITER *dirState, const char *path)
 {
     struct nitroDIRStruct *dirStruct = (struct nitroDIRStruct *)dirState->dirStruct; //this makes it lots easier!
-    struct stat st;
-    char dirname[NITRONAMELENMAX];
-    char *cptr;
-    char mydirpath[NITROMAXPATHLEN]; //to hold copy of path string
-    char *dirpath = mydirpath;
-    bool pathfound;
-    if ((cptr = strchr(path, ':')))
-        path = cptr + 1;                           //move path past any device names (if it was nixy style wouldnt need this step >_>)
-    strncpy(dirpath, path, sizeof(mydirpath) - 1); //copy the string (as im gonna mutalate it)
-    dirStruct->pos = 0;
-    if (*dirpath == '/')                   //if first character is '/' use absolute root path plz
-        dirStruct->cur_dir_id = NITROROOT; //first root dir
-    else
-        dirStruct->cur_dir_id = chdirpathid; //else use chdirpath
-    nitroDirReset(r, dirState);              //set dir to current path
-    do
-    {
-        while ((cptr = strchr(dirpath, '/')) == dirpath)
-        {
-            dirpath++; //move past any leading / or // together
-        }
-        if (cptr)
-            *cptr = 0; //erase /
-        if (*dirpath == 0)
-        {                     //are we at the end of the path string?? if so there is nothing to search for we're already here !
-            pathfound = true; //mostly this handles searches for root or /  or no path specified cases
-            break;
-        }
-        pathfound = false;
-        while (nitroFSDirNext(r, dirState, dirname, &st) == 0)
-        {
-            if ((st.st_mode == S_IFDIR) && !(strcmp(dirname, dirpath)))
-            {                                              //if its a directory and name matches dirpath
-                dirStruct->cur_dir_id = dirStruct->dir_id; //move us to the next dir in tree
-                nitroDirReset(r, dirState);                //set dir to current path we just found...
-                pathfound = true;
-                break;
-            }
-        };
-        if (!pathfound)
-            break;
-        dirpath = cptr + 1; //move to right after last / we found
-    } while (cptr);         // go till after the last /
-    if (pathfound)
+    u16 id;
+    if (nitroResolvePath(path, &id) && nitroIsDir(id))
     {
+        dirStruct->pos = 0;
+        dirStruct->cur_dir_id = id;
+        nitroDirReset(r, dirState); //set dir to the path we just found
         return (dirState);
     }
     else
@@ -250,14 +559,11 @@ const char *syspaths[2] = {
 int nitroDirReset(struct _reent *r, DIR_ITER *dirState)
 {
     struct nitroDIRStruct *dirStruct = (struct nitroDIRStruct *)dirState->dirStruct; //this makes it lots easier!
-    struct ROM_FNTDir dirsubtable;
-    off_t *pos = &dirStruct->pos;
-    nitroSubSeek(pos, fntOffset + ((dirStruct->cur_dir_id & NITRODIRMASK) * sizeof(struct ROM_FNTDir)), SEEK_SET);
-    nitroSubRead(pos, &dirsubtable, sizeof(dirsubtable));
-    dirStruct->namepos = dirsubtable.entry_start;    //set namepos to first entry in this dir's table
-    dirStruct->entry_id = dirsubtable.entry_file_id; //get number of first file ID in this branch
-    dirStruct->parent_id = dirsubtable.parent_id;    //save parent ID in case we wanna add ../ functionality
-    dirStruct->spc = 0;                              //system path counter, first two dirnext's deliver . and ..
+    struct ROM_FNTDir *dirsubtable = &((struct ROM_FNTDir *)fntData)[dirStruct->cur_dir_id & NITRODIRMASK];
+    dirStruct->namepos = dirsubtable->entry_start;    //set namepos to first entry in this dir's table
+    dirStruct->entry_id = dirsubtable->entry_file_id; //get number of first file ID in this branch
+    dirStruct->parent_id = dirsubtable->parent_id;    //save parent ID in case we wanna add ../ functionality
+    dirStruct->spc = 0;                               //system path counter, first two dirnext's deliver . and ..
     return (0);
 }
 
@@ -265,7 +571,6 @@ int nitroFSDirNext(struct _reent *r, DIR_ITER *dirState, char *filename, struct
 {
     unsigned char next;
     struct nitroDIRStruct *dirStruct = (struct nitroDIRStruct *)dirState->dirStruct; //this makes it lots easier!
-    off_t *pos = &dirStruct->pos;
     if (dirStruct->spc <= 1)
     {
         if (st)
@@ -281,33 +586,33 @@ int nitroFSDirNext(struct _reent *r, DIR_ITER *dirState, char *filename, struct
         strcpy(filename, syspaths[dirStruct->spc++]);
         return (0);
     }
-    nitroSubSeek(pos, fntOffset + dirStruct->namepos, SEEK_SET);
-    nitroSubRead(pos, &next, sizeof(next));
     // next: high bit 0x80 = entry isdir.. other 7 bits r size, the 16 bits following name are dir's entryid (starts with f000)
     //  00 = endoftable //
+    next = (dirStruct->namepos < fntSize) ? fntData[dirStruct->namepos] : 0;
     if (next)
     {
+        const u8 *name = fntData + dirStruct->namepos + 1;
         if (next & NITROISDIR)
         {
             if (st)
                 st->st_mode = S_IFDIR;
-            next &= NITROISDIR ^ 0xff; //invert bits and mask off 0x80
-            nitroSubRead(pos, filename, next);
-            nitroSubRead(&dirStruct->pos, &dirStruct->dir_id, sizeof(dirStruct->dir_id)); //read the dir_id
-                                                                                          //grr cant get the struct member size?, just wanna test it so moving on...
-                                                                                          //			nitroSubRead(pos,&dirStruct->dir_id,sizeof(u16)); //read the dir_id
-            dirStruct->namepos += next + sizeof(u16) + 1;                                 //now we points to next one plus dir_id size:D
+            next &= NITROISDIR ^ 0xff;                    //invert bits and mask off 0x80
+            tonccpy(filename, name, next);
+            dirStruct->dir_id = nitroRead16(name + next); //read the dir_id
+            dirStruct->namepos += next + sizeof(u16) + 1; //now we points to next one plus dir_id size:D
         }
         else
         {
             if (st)
                 st->st_mode = 0;
-            nitroSubRead(pos, filename, next);
+            tonccpy(filename, name, next);
             dirStruct->namepos += next + 1; //now we points to next one :D
-            //read file info to get filesize (and for fileopen)
-            nitroSubSeek(pos, fatOffset + (dirStruct->entry_id * sizeof(struct ROM_FAT)), SEEK_SET);
-            nitroSubRead(pos, &dirStruct->romfat, sizeof(dirStruct->romfat)); //retrieve romfat entry (contains filestart and end positions)
-            dirStruct->entry_id++;                                            //advance ROM_FNTStrFile ptr
+            //file info to get filesize (and for fileopen)
+            if (dirStruct->entry_id < fatCount)
+                dirStruct->romfat = fatData[dirStruct->entry_id]; //romfat entry (contains filestart and end positions)
+            else
+                dirStruct->romfat.top = dirStruct->romfat.bottom = 0;
+            dirStruct->entry_id++;                                //advance ROM_FNTStrFile ptr
             if (st)
                 st->st_size = dirStruct->romfat.bottom - dirStruct->romfat.top; //calculate filesize
         }
@@ -325,60 +630,20 @@ int nitroFSDirNext(struct _reent *r, DIR_ITER *dirState, char *filename, struct
 int nitroFSOpen(struct _reent *r, void *fileStruct, const char *path, int flags, int mode)
 {
     struct nitroFSStruct *fatStruct = (struct nitroFSStruct *)fileStruct;
-    struct nitroDIRStruct dirStruct;
-    DIR_ITER dirState;
-    dirState.dirStruct = &dirStruct; //create a temp dirstruct
-    struct _reent dre;
-    struct stat st;                     //all these are just used for reading the dir ~_~
-    char dirfilename[NITROMAXPATHLEN];  // to hold a full path (i tried to avoid using so much stack but blah :/)
-    char *filename;                     // to hold filename
-    char *cptr;                         //used to string searching and manipulation
-    cptr = (char *)path + strlen(path); //find the end...
-    filename = NULL;
-    do
-    {
-        if ((*cptr == '/') || (*cptr == ':'))
-        { // split at either / or : (whichever comes first form the end!)
-            cptr++;
-            strncpy(dirfilename, path, cptr - path); //copy string up till and including/ or : zero rest
-            dirfilename[cptr - path] = 0;            //it seems strncpy doesnt always zero?!
-            filename = cptr;                         //filename = now remainder of string
-            break;
-        }
-    } while (cptr-- != path); //search till start
-    if (!filename)
-    {                            //we didnt find a / or : ? shouldnt realyl happen but if it does...
-        filename = (char *)path; //filename = complete path
-        dirfilename[0] = 0;      //make directory path ""
-    }
-    if (nitroFSDirOpen(&dre, &dirState, dirfilename))
-    {
-        fatStruct->start = 0;
-        while (nitroFSDirNext(&dre, &dirState, dirfilename, &st) == 0)
-        {
-            if (!(st.st_mode & S_IFDIR) && (strcmp(dirfilename, filename) == 0))
-            { //Found the *file* youre looking for!!
-                fatStruct->start = dirStruct.romfat.top;
-                fatStruct->end = dirStruct.romfat.bottom;
-                if (hasLoader)
-                {
-                    fatStruct->start += LOADEROFFSET;
-                    fatStruct->end += LOADEROFFSET;
-                }
-                break;
-            }
-        }
-        if (fatStruct->start)
+    u16 id;
+    if (nitroResolvePath(path, &id) && id < NITROROOT && id < fatCount)
+    { //Found the *file* youre looking for!!
+        fatStruct->start = fatData[id].top;
+        fatStruct->end = fatData[id].bottom;
+        if (hasLoader)
         {
-            nitroSubSeek(&fatStruct->pos, fatStruct->start, SEEK_SET); //seek to start of file
-            return (0);                                                //woot!
+            fatStruct->start += LOADEROFFSET;
+            fatStruct->end += LOADEROFFSET;
         }
-        nitroFSDirClose(&dre, &dirState);
-    }
-    if (r->_errno == 0)
-    {
-        r->_errno = ENOENT;
+        nitroSubSeek(&fatStruct->pos, fatStruct->start, SEEK_SET); //seek to start of file
+        return (0);                                                //woot!
     }
+    r->_errno = ENOENT;
     return (-1); //teh fail
 }
 
@@ -422,24 +687,20 @@ int nitroFSFstat(struct _reent *r, void* fd, struct stat *st)
 
 int nitroFSstat(struct _reent *r, const char *file, struct stat *st)
 {
-    struct nitroFSStruct fatStruct;
-    struct nitroDIRStruct dirStruct;
-    DIR_ITER dirState;
-
-    if (nitroFSOpen(NULL, &fatStruct, file, 0, 0) >= 0)
-    {
-        st->st_mode = S_IFREG;
-        st->st_size = fatStruct.end - fatStruct.start;
-        return (0);
-    }
-
-    dirState.dirStruct = &dirStruct;
-    if ((nitroFSDirOpen(r, &dirState, file) != NULL))
+    u16 id;
+    if (nitroResolvePath(file, &id))
     {
-
-        st->st_mode = S_IFDIR;
-        nitroFSDirClose(r, &dirState);
-        return (0);
+        if (id < NITROROOT && id < fatCount)
+        {
+            st->st_mode = S_IFREG;
+            st->st_size = fatData[id].bottom - fatData[id].top;
+            return (0);
+        }
+        else if (nitroIsDir(id))
+        {
+            st->st_mode = S_IFDIR;
+            return (0);
+        }
     }
     r->_errno = ENOENT;
     return (-1);
@@ -447,13 +708,10 @@ int nitroFSstat(struct _reent *r, const char *file, struct stat *st)
 
 int nitroFSChdir(struct _reent *r, const char *name)
 {
-    struct nitroDIRStruct dirStruct;
-    DIR_ITER dirState;
-    dirState.dirStruct = &dirStruct;
-    if ((name != NULL) && (nitroFSDirOpen(r, &dirState, name) != NULL))
+    u16 id;
+    if ((name != NULL) && nitroResolvePath(name, &id) && nitroIsDir(id))
     {
-        chdirpathid = dirStruct.cur_dir_id;
-        nitroFSDirClose(r, &dirState);
+        chdirpathid = id;
         return (0);
     }
     else
@@ -461,4 +719,152 @@ int nitroFSChdir(struct _reent *r, const char *name)
         r->_errno = ENOENT;
         return (-1);
     }
-}
\ No newline at end of file
+}
+
+//one file queued by nitroFSExtract()
+struct nitroExtractFile
+{
+    u32 top;        //start in the image
+    u32 bottom;     //end in the image
+    u32 nameOffset; //offset in fntData of the name's length byte
+    u16 dir;        //directory it's in (without the 0xf000)
+};
+
+static int nitroExtractCompare(const void *a, const void *b)
+{
+    const struct nitroExtractFile *fa = (const struct nitroExtractFile *)a;
+    const struct nitroExtractFile *fb = (const struct nitroExtractFile *)b;
+    if (fa->top != fb->top)
+        return fa->top < fb->top ? -1 : 1;
+    return 0;
+}
+
+//copies the directory at path and everything under it to destPath
+//the tree is gathered from the in-RAM FNT, all directories are created first and then
+//the files are written in rom offset order so the image is read front to back
+int nitroFSExtract(const char *path, const char *destPath, nitroFSExtractCallback callback)
+{
+    u16 root, dirCount;
+    char **dirPaths = NULL;
+    u16 *queue = NULL;
+    struct nitroExtractFile *files = NULL;
+    u8 *buf = NULL;
+    u32 fileCount = 0, qn = 0, total = 0, done = 0;
+    char outPath[NITROMAXPATHLEN * 2];
+    int ret = -1;
+
+    if (!fntData || !nitroResolvePath(path, &root) || !nitroIsDir(root))
+        return (-1);
+
+    dirCount = nitroDirCount();
+    dirPaths = (char **)calloc(dirCount, sizeof(char *));
+    queue = (u16 *)malloc(dirCount * sizeof(u16));
+    files = (struct nitroExtractFile *)malloc((fatCount ? fatCount : 1) * sizeof(struct nitroExtractFile));
+    buf = (u8 *)malloc(NITROCACHEMAX);
+    if (!dirPaths || !queue || !files || !buf)
+        goto cleanup;
+
+    //gather the tree breadth first, working out each directory's destination as we go
+    dirPaths[root & NITRODIRMASK] = strdup(destPath);
+    queue[qn++] = root & NITRODIRMASK;
+    for (u32 qi = 0; qi < qn; qi++)
+    {
+        u16 dir = queue[qi];
+        struct ROM_FNTDir *dirsubtable = &((struct ROM_FNTDir *)fntData)[dir];
+        u32 namepos = dirsubtable->entry_start;
+        u16 file_id = dirsubtable->entry_file_id;
+        u8 next;
+        if (!dirPaths[dir])
+            goto cleanup;
+        while (namepos < fntSize && (next = fntData[namepos]) != 0)
+        {
+            u8 len = next & (NITROISDIR ^ 0xff);
+            if (next & NITROISDIR)
+            {
+                u16 child = nitroRead16(fntData + namepos + 1 + len) & NITRODIRMASK;
+                if (child < dirCount && !dirPaths[child])
+                {
+                    snprintf(outPath, sizeof(outPath), "%s/%.*s", dirPaths[dir], len, fntData + namepos + 1);
+                    dirPaths[child] = strdup(outPath);
+                    queue[qn++] = child;
+                }
+                namepos += 1 + len + sizeof(u16);
+            }
+            else
+            {
+                if (file_id < fatCount)
+                {
+                    if (fileCount >= fatCount)
+                        goto cleanup; //directories' file ids overlap, the FNT is bad
+                    struct nitroExtractFile *file = &files[fileCount++];
+                    file->top = fatData[file_id].top + (hasLoader ? LOADEROFFSET : 0);
+                    file->bottom = fatData[file_id].bottom + (hasLoader ? LOADEROFFSET : 0);
+                    file->nameOffset = namepos;
+                    file->dir = dir;
+                    if (file->bottom > file->top)
+                        total += file->bottom - file->top;
+                }
+                file_id++;
+                namepos += 1 + len;
+            }
+        }
+    }
+
+    //let the caller check the total before anything is written
+    if (callback && !callback(0, total, NULL))
+        goto cleanup;
+
+    for (u32 qi = 0; qi < qn; qi++)
+    {
+        if (mkdir(dirPaths[queue[qi]], 0777) != 0 && errno != EEXIST)
+            goto cleanup;
+    }
+
+    qsort(files, fileCount, sizeof(struct nitroExtractFile), nitroExtractCompare);
+
+    for (u32 i = 0; i < fileCount; i++)
+    {
+        struct nitroExtractFile *file = &files[i];
+        u8 len = fntData[file->nameOffset];
+        off_t pos = file->top;
+        FILE *out;
+
+        snprintf(outPath, sizeof(outPath), "%s/%.*s", dirPaths[file->dir], len, fntData + file->nameOffset + 1);
+        if (!(out = fopen(outPath, "wb")))
+            goto cleanup;
+
+        while (pos < (off_t)file->bottom)
+        {
+            size_t chunk = file->bottom - pos;
+            if (chunk > NITROCACHEMAX)
+                chunk = NITROCACHEMAX;
+            ssize_t numr = nitroSubRead(&pos, buf, chunk);
+            if (numr <= 0 || fwrite(buf, 1, numr, out) != (size_t)numr)
+            {
+                fclose(out);
+                goto cleanup;
+            }
+            done += numr;
+            if (callback && !callback(done, total, outPath))
+            { //cancelled, dont leave a partial file behind
+                fclose(out);
+                remove(outPath);
+                goto cleanup;
+            }
+        }
+        fclose(out);
+    }
+    ret = 0;
+
+cleanup:
+    if (dirPaths)
+    {
+        for (u16 i = 0; i < dirCount; i++)
+            free(dirPaths[i]);
+    }
+    free(dirPaths);
+    free(queue);
+    free(files);
+    free(buf);
+    return (ret);
+}
@@ -47,6 +47,7 @@ extern "C"
 #endif
 
     int nitroFSInit(const char *ndsfile);
+    int nitroFSInitCard(void);
     DIR_ITER *nitroFSDirOpen(struct _reent *r, DIR_ITER *dirState, const char *path);
     int nitroDirReset(struct _reent *r, DIR_ITER *dirState);
     int nitroFSDirNext(struct _reent *r, DIR_ITER *dirState, char *filename, struct stat *st);
@@ -58,11 +59,17 @@ extern "C"
     int nitroFSFstat(struct _reent *r, void *fd, struct stat *st);
     int nitroFSstat(struct _reent *r, const char *file, struct stat *st);
     int nitroFSChdir(struct _reent *r, const char *name);
+
+    //progress callback for nitroFSExtract, path is NULL for the first call, return false to cancel
+    typedef bool (*nitroFSExtractCallback)(u32 done, u32 total, const char *path);
+    int nitroFSExtract(const char *path, const char *destPath, nitroFSExtractCallback callback);
 #define LOADERSTR "PASS" //look for this
 #define LOADERSTROFFSET 0xac
 #define LOADEROFFSET 0x0200
 #define FNTOFFSET 0x40
+#define FNTSIZEOFFSET 0x44
 #define FATOFFSET 0x48
+#define FATSIZEOFFSET 0x4C
 
 #define NITRONAMELENMAX 0x80  //max file name is 127 +1 for zero byte :D
 #define NITROMAXPATHLEN 0x100 //256 bytes enuff?
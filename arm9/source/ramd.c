@@ -2,6 +2,9 @@
 #include <nds.h>
 #include <nds/ndstypes.h>
 #include <nds/disc_io.h>
+#include <stdio.h>
+#include <string.h>
+#include "ramd.h"
 #include "tonccpy.h"
 
 #define SECTOR_SIZE 512
@@ -16,72 +19,672 @@ const static u8 bootSector[] = {
 u32 ramdSectors = 0;
 u8* ramdLoc = (u8*)NULL;
 u8* ramdLocMep = (u8*)NULL;
+bool ramdCompressed = false;
 const u16 bootSectorSignature = 0xAA55;
+static bool ramdTwl = false;
+static u32 ramdPhysicalSectors = 0;
+
+// Compressed store: the drive is split into groups of sectors, each kept as
+// either a hole (all zeros), LZ10 data or raw sectors in blocks of the RAM
+// pool. A few groups are kept decompressed and written back on eviction.
+#define RAMD_GROUP_SECTORS 8
+#define RAMD_GROUP_SIZE (RAMD_GROUP_SECTORS * SECTOR_SIZE)
+#define RAMD_CACHE_GROUPS 4
+
+typedef struct {
+	u16 blocks[RAMD_GROUP_SECTORS];
+	u8 blockCount;	// 0 means the group is all zeros
+	bool compressed;
+} RamdGroup;
+
+typedef struct {
+	u32 group;
+	u32 lastUsed;
+	bool valid;
+	bool dirty;
+	u8 *data;
+} RamdCacheEntry;
+
+static RamdGroup *ramdGroups = NULL;
+static u32 ramdGroupCount = 0;
+static u32 *ramdBlockBitmap = NULL;
+static u32 ramdBlocksUsed = 0;
+static u32 ramdBlockHint = 0;
+static RamdCacheEntry ramdCache[RAMD_CACHE_GROUPS];
+static u32 ramdCacheTick = 0;
+static u8 *ramdScratch = NULL;
+static u16 *ramdHashTable = NULL;
+
+static bool ramd_raw_write_sectors(sec_t sector, sec_t numSectors, const void *buffer);
+bool ramd_write_sectors(sec_t sector, sec_t numSectors, const void *buffer);
+static void ramd_compressed_free(void);
+static bool ramd_compressed_init(void);
+static bool ramd_snapshot_load(FILE *file);
+
+static FILE *ramdRestoreFile = NULL;
+static bool ramdRestoreSucceeded = false;
+
+// Writes a fresh boot sector and clears the FATs and root directory
+static bool ramd_format(void) {
+	u8 sector[SECTOR_SIZE];
+	toncset(sector, 0, sizeof(sector));
+	tonccpy(sector, bootSector, sizeof(bootSector));
+	tonccpy(sector + 0x20, &ramdSectors, 4);
+	tonccpy(sector + 0x1FE, &bootSectorSignature, 2);
+
+	// Make sure the FAT can address every cluster (4 sectors each, FAT16)
+	u16 fatSectors = ((ramdSectors / 4 + 2) * 2 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+	if(fatSectors > 0x20)
+		tonccpy(sector + 0x16, &fatSectors, 2);
+	else
+		fatSectors = 0x20;
+
+	if(!ramd_write_sectors(0, 1, sector))
+		return false;
+
+	toncset(sector, 0, sizeof(sector));
+	u32 metadataSectors = 2 * fatSectors + (0x200 * 32) / SECTOR_SIZE;
+	for(u32 i = 1; i <= metadataSectors; i++) {
+		if(!ramd_write_sectors(i, 1, sector))
+			return false;
+	}
+
+	return true;
+}
 
 bool ramd_startup() {
-	if(isDSiMode() || REG_SCFG_EXT != 0) {
+	ramdTwl = isDSiMode() || REG_SCFG_EXT != 0;
+	if(ramdTwl) {
 		ramdLoc = (u8*)malloc(0x6000 * SECTOR_SIZE);
 	} else {
 		ramdLoc = (u8*)calloc(0x8 * SECTOR_SIZE, 1);
 		toncset(ramdLocMep, 0, (ramdSectors - 0x8) * SECTOR_SIZE); // Fill MEP with 00 to avoid displaying weird files
 	}
 
-	tonccpy(ramdLoc, bootSector, sizeof(bootSector));
-	tonccpy(ramdLoc + 0x20, &ramdSectors, 4);
-	tonccpy(ramdLoc + 0x1FE, &bootSectorSignature, 2);
+	// The compressed store needs heap for its tables and only exists in the
+	// TWL RAM, fall back to a plain drive if it can't be set up
+	ramdPhysicalSectors = ramdSectors;
+	if(ramdCompressed && !(ramdTwl && ramd_compressed_init()))
+		ramdCompressed = false;
+	if(ramdCompressed)
+		ramdSectors = ramdGroupCount * RAMD_GROUP_SECTORS;
 
-	return true;
+	if(ramdRestoreFile) {
+		ramdRestoreSucceeded = ramd_snapshot_load(ramdRestoreFile);
+		ramdRestoreFile = NULL;
+		if(ramdRestoreSucceeded)
+			return true;
+	}
+
+	return ramd_format();
 }
 
 bool ramd_is_inserted() {
 	return isDSiMode() || REG_SCFG_EXT != 0 || *(u16*)(0x020000C0) != 0 || *(vu16*)(0x08240000) == 1;
 }
 
-bool ramd_read_sectors(sec_t sector, sec_t numSectors, void *buffer) {
-	for(int i = 0; i < numSectors; i++, sector++) {
-		if(isDSiMode() || REG_SCFG_EXT != 0) {
-			if(sector < 0x6000) {
-				tonccpy(buffer + (i * SECTOR_SIZE), ramdLoc + (sector * SECTOR_SIZE), SECTOR_SIZE);
-			} else if(sector <= 0xE000) {
-				tonccpy(buffer + (i * SECTOR_SIZE), (void*)0x0D000000 + ((sector - 0x6000) * SECTOR_SIZE), SECTOR_SIZE);
+// Finds where a sector lives and how many sectors follow it in the same
+// backing region, so a request is at most one copy per region
+static u8 *ramd_sector_region(sec_t sector, sec_t *contiguous, bool *slot2) {
+	*slot2 = false;
+	if(ramdTwl) {
+		if(sector < 0x6000) {
+			*contiguous = 0x6000 - sector;
+			return ramdLoc + (sector * SECTOR_SIZE);
+		} else if(sector < ramdPhysicalSectors) {
+			*contiguous = ramdPhysicalSectors - sector;
+			return (u8*)0x0D000000 + ((sector - 0x6000) * SECTOR_SIZE);
+		}
+	} else if(sector < 0x8) {
+		*contiguous = 0x8 - sector;
+		return ramdLoc + (sector * SECTOR_SIZE);
+	} else if(sector < ramdPhysicalSectors) {
+		*contiguous = ramdPhysicalSectors - sector;
+		*slot2 = true;
+		return ramdLocMep + ((sector - 0x8) * SECTOR_SIZE);
+	}
+
+	return NULL;
+}
+
+static inline void ramd_copy(void *dst, const void *src, u32 size, bool slot2) {
+	// The Slot-2 bus can't take byte writes, so only main RAM gets
+	// newlib's ldm/stm memcpy
+	if(slot2)
+		tonccpy(dst, src, size);
+	else
+		memcpy(dst, src, size);
+}
+
+static bool ramd_raw_read_sectors(sec_t sector, sec_t numSectors, void *buffer) {
+	while(numSectors > 0) {
+		sec_t count;
+		bool slot2;
+		u8 *src = ramd_sector_region(sector, &count, &slot2);
+		if(!src)
+			return false;
+
+		if(count > numSectors)
+			count = numSectors;
+
+		ramd_copy(buffer, src, count * SECTOR_SIZE, slot2);
+		buffer += count * SECTOR_SIZE;
+		sector += count;
+		numSectors -= count;
+	}
+
+	return true;
+}
+
+static bool ramd_raw_write_sectors(sec_t sector, sec_t numSectors, const void *buffer) {
+	while(numSectors > 0) {
+		sec_t count;
+		bool slot2;
+		u8 *dst = ramd_sector_region(sector, &count, &slot2);
+		if(!dst)
+			return false;
+
+		if(count > numSectors)
+			count = numSectors;
+
+		ramd_copy(dst, buffer, count * SECTOR_SIZE, slot2);
+		buffer += count * SECTOR_SIZE;
+		sector += count;
+		numSectors -= count;
+	}
+
+	return true;
+}
+
+// Nintendo LZ10, so the BIOS can decompress it. Returns 0 once the output
+// is too big to save at least one block over storing the group raw.
+static u32 ramd_compress(const u8 *src, u8 *dst) {
+	const u32 limit = RAMD_GROUP_SIZE - SECTOR_SIZE;
+	toncset16(ramdHashTable, 0, 0x1000);
+
+	dst[0] = 0x10;
+	dst[1] = RAMD_GROUP_SIZE & 0xFF;
+	dst[2] = (RAMD_GROUP_SIZE >> 8) & 0xFF;
+	dst[3] = RAMD_GROUP_SIZE >> 16;
+
+	u32 in = 0, out = 4;
+	while(in < RAMD_GROUP_SIZE) {
+		u32 flagPos = out++;
+		u8 flags = 0;
+		for(int bit = 7; bit >= 0 && in < RAMD_GROUP_SIZE; bit--) {
+			u32 length = 0, distance = 0;
+			if(in + 3 <= RAMD_GROUP_SIZE) {
+				// Hash table holds the last position + 1 for each 3 byte prefix
+				u32 hash = ((src[in] << 4) ^ (src[in + 1] << 2) ^ src[in + 2]) & 0xFFF;
+				u32 candidate = ramdHashTable[hash];
+				ramdHashTable[hash] = in + 1;
+				if(candidate--) {
+					u32 max = RAMD_GROUP_SIZE - in < 18 ? RAMD_GROUP_SIZE - in : 18;
+					while(length < max && src[candidate + length] == src[in + length])
+						length++;
+					distance = in - candidate;
+				}
+			}
+
+			if(length >= 3) {
+				flags |= 1 << bit;
+				dst[out++] = ((length - 3) << 4) | ((distance - 1) >> 8);
+				dst[out++] = (distance - 1) & 0xFF;
+				for(u32 i = 1; i < length && in + i + 3 <= RAMD_GROUP_SIZE; i++) {
+					u32 hash = ((src[in + i] << 4) ^ (src[in + i + 1] << 2) ^ src[in + i + 2]) & 0xFFF;
+					ramdHashTable[hash] = in + i + 1;
+				}
+				in += length;
+			} else {
+				dst[out++] = src[in++];
 			}
-		} else if(sector < 0x8) {
-			tonccpy(buffer + (i * SECTOR_SIZE), ramdLoc + (sector * SECTOR_SIZE), SECTOR_SIZE);
-		} else if(sector <= ramdSectors - 0x8) {
-			tonccpy(buffer + (i * SECTOR_SIZE), ramdLocMep + ((sector - 0x8) * SECTOR_SIZE), SECTOR_SIZE);
+		}
+		dst[flagPos] = flags;
+
+		if(out > limit)
+			return 0;
+	}
+
+	return out;
+}
+
+static bool ramd_is_zero(const u8 *data) {
+	const u32 *words = (const u32 *)data;
+	for(u32 i = 0; i < RAMD_GROUP_SIZE / 4; i++) {
+		if(words[i] != 0)
+			return false;
+	}
+
+	return true;
+}
+
+static int ramd_block_alloc(void) {
+	u32 words = (ramdPhysicalSectors + 31) / 32;
+	for(u32 i = 0; i < words; i++) {
+		u32 word = (ramdBlockHint + i) % words;
+		if(ramdBlockBitmap[word] == 0xFFFFFFFF)
+			continue;
+
+		for(u32 bit = 0; bit < 32; bit++) {
+			u32 block = word * 32 + bit;
+			if(block < ramdPhysicalSectors && !(ramdBlockBitmap[word] & (1u << bit))) {
+				ramdBlockBitmap[word] |= (1u << bit);
+				ramdBlockHint = word;
+				ramdBlocksUsed++;
+				return block;
+			}
+		}
+	}
+
+	return -1;
+}
+
+static void ramd_block_free(u32 block) {
+	ramdBlockBitmap[block / 32] &= ~(1u << (block % 32));
+	ramdBlocksUsed--;
+}
+
+static bool ramd_group_load(u32 group, u8 *data) {
+	RamdGroup *entry = &ramdGroups[group];
+	if(entry->blockCount == 0) {
+		toncset(data, 0, RAMD_GROUP_SIZE);
+		return true;
+	}
+
+	u8 *dst = entry->compressed ? ramdScratch : data;
+	for(u32 i = 0; i < entry->blockCount; i++) {
+		if(!ramd_raw_read_sectors(entry->blocks[i], 1, dst + i * SECTOR_SIZE))
+			return false;
+	}
+
+	if(entry->compressed)
+		decompress(ramdScratch, data, LZ77);
+	return true;
+}
+
+static bool ramd_group_store(u32 group, const u8 *data) {
+	RamdGroup *entry = &ramdGroups[group];
+
+	const u8 *src = NULL;
+	u32 needed = 0;
+	bool compressed = false;
+	if(!ramd_is_zero(data)) {
+		u32 size = ramd_compress(data, ramdScratch);
+		if(size > 0) {
+			src = ramdScratch;
+			needed = (size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+			compressed = true;
 		} else {
+			src = data;
+			needed = RAMD_GROUP_SECTORS;
+		}
+	}
+
+	// Reuse the group's current blocks, only allocating what's missing so
+	// nothing is lost if the pool is full
+	u32 count = entry->blockCount;
+	while(count < needed) {
+		int block = ramd_block_alloc();
+		if(block < 0) {
+			while(count > entry->blockCount)
+				ramd_block_free(entry->blocks[--count]);
 			return false;
 		}
+		entry->blocks[count++] = block;
+	}
+	while(count > needed)
+		ramd_block_free(entry->blocks[--count]);
+
+	for(u32 i = 0; i < needed; i++) {
+		if(!ramd_raw_write_sectors(entry->blocks[i], 1, src + i * SECTOR_SIZE))
+			return false;
 	}
 
+	entry->blockCount = needed;
+	entry->compressed = compressed;
 	return true;
 }
 
-bool ramd_write_sectors(sec_t sector, sec_t numSectors, const void *buffer) {
-	for(int i = 0; i < numSectors; i++, sector++) {
-		if(isDSiMode() || REG_SCFG_EXT != 0) {
-			if(sector < 0x6000) {
-				tonccpy(ramdLoc + (sector * SECTOR_SIZE), buffer + (i * SECTOR_SIZE), SECTOR_SIZE);
-			} else if(sector <= 0xE000) {
-				tonccpy((void*)0x0D000000 + ((sector - 0x6000) * SECTOR_SIZE), buffer + (i * SECTOR_SIZE), SECTOR_SIZE);
+bool ramd_flush(void) {
+	if(!ramdCompressed)
+		return true;
+
+	bool success = true;
+	for(int i = 0; i < RAMD_CACHE_GROUPS; i++) {
+		RamdCacheEntry *entry = &ramdCache[i];
+		if(entry->valid && entry->dirty) {
+			if(ramd_group_store(entry->group, entry->data))
+				entry->dirty = false;
+			else
+				success = false;
+		}
+	}
+
+	return success;
+}
+
+// Returns the decompressed group, loading it if needed. When the whole
+// group is about to be overwritten the old contents aren't read back.
+static u8 *ramd_group_get(u32 group, bool overwrite) {
+	RamdCacheEntry *entry = NULL;
+	for(int i = 0; i < RAMD_CACHE_GROUPS; i++) {
+		if(ramdCache[i].valid && ramdCache[i].group == group) {
+			entry = &ramdCache[i];
+			break;
+		}
+	}
+
+	if(!entry) {
+		// Evict a clean group if there is one, so reads still work when the
+		// pool is too full to store a dirty one
+		for(int i = 0; i < RAMD_CACHE_GROUPS; i++) {
+			RamdCacheEntry *candidate = &ramdCache[i];
+			if(!candidate->valid) {
+				entry = candidate;
+				break;
 			}
-		} else if(sector < 0x8) {
-			tonccpy(ramdLoc + (sector * SECTOR_SIZE), buffer + (i * SECTOR_SIZE), SECTOR_SIZE);
-		} else if(sector <= ramdSectors - 0x8) {
-			tonccpy(ramdLocMep + ((sector - 0x8) * SECTOR_SIZE), buffer + (i * SECTOR_SIZE), SECTOR_SIZE);
-		} else {
+			if(!entry || (entry->dirty && !candidate->dirty)
+			 || (entry->dirty == candidate->dirty && candidate->lastUsed < entry->lastUsed))
+				entry = candidate;
+		}
+
+		if(entry->valid && entry->dirty) {
+			if(!ramd_group_store(entry->group, entry->data))
+				return NULL;
+			entry->dirty = false;
+		}
+
+		entry->valid = false;
+		if(!overwrite && !ramd_group_load(group, entry->data))
+			return NULL;
+
+		entry->group = group;
+		entry->valid = true;
+	}
+
+	entry->lastUsed = ++ramdCacheTick;
+	return entry->data;
+}
+
+static bool ramd_compressed_read_sectors(sec_t sector, sec_t numSectors, void *buffer) {
+	if(sector + numSectors > ramdSectors)
+		return false;
+
+	while(numSectors > 0) {
+		u32 offset = sector % RAMD_GROUP_SECTORS;
+		u32 count = RAMD_GROUP_SECTORS - offset;
+		if(count > numSectors)
+			count = numSectors;
+
+		u8 *data = ramd_group_get(sector / RAMD_GROUP_SECTORS, false);
+		if(!data)
 			return false;
+
+		memcpy(buffer, data + offset * SECTOR_SIZE, count * SECTOR_SIZE);
+		buffer += count * SECTOR_SIZE;
+		sector += count;
+		numSectors -= count;
+	}
+
+	return true;
+}
+
+static bool ramd_compressed_write_sectors(sec_t sector, sec_t numSectors, const void *buffer) {
+	if(sector + numSectors > ramdSectors)
+		return false;
+
+	while(numSectors > 0) {
+		u32 offset = sector % RAMD_GROUP_SECTORS;
+		u32 count = RAMD_GROUP_SECTORS - offset;
+		if(count > numSectors)
+			count = numSectors;
+
+		u8 *data = ramd_group_get(sector / RAMD_GROUP_SECTORS, count == RAMD_GROUP_SECTORS);
+		if(!data)
+			return false;
+
+		memcpy(data + offset * SECTOR_SIZE, buffer, count * SECTOR_SIZE);
+		for(int i = 0; i < RAMD_CACHE_GROUPS; i++) {
+			if(ramdCache[i].data == data)
+				ramdCache[i].dirty = true;
 		}
+
+		buffer += count * SECTOR_SIZE;
+		sector += count;
+		numSectors -= count;
+	}
+
+	return true;
+}
+
+static void ramd_compressed_free(void) {
+	free(ramdGroups);
+	free(ramdBlockBitmap);
+	free(ramdScratch);
+	free(ramdHashTable);
+	ramdGroups = NULL;
+	ramdBlockBitmap = NULL;
+	ramdScratch = NULL;
+	ramdHashTable = NULL;
+	for(int i = 0; i < RAMD_CACHE_GROUPS; i++) {
+		free(ramdCache[i].data);
+		ramdCache[i].data = NULL;
+		ramdCache[i].valid = false;
+	}
+	ramdGroupCount = 0;
+	ramdBlocksUsed = 0;
+	ramdBlockHint = 0;
+}
+
+static bool ramd_compressed_init(void) {
+	ramdGroupCount = ramdPhysicalSectors * RAMD_COMPRESS_RATIO / RAMD_GROUP_SECTORS;
+	ramdGroups = (RamdGroup*)calloc(ramdGroupCount, sizeof(RamdGroup));
+	ramdBlockBitmap = (u32*)calloc((ramdPhysicalSectors + 31) / 32, sizeof(u32));
+	ramdScratch = (u8*)malloc(RAMD_GROUP_SIZE + 32);
+	ramdHashTable = (u16*)malloc(0x1000 * sizeof(u16));
+	bool success = ramdGroups && ramdBlockBitmap && ramdScratch && ramdHashTable;
+	for(int i = 0; i < RAMD_CACHE_GROUPS; i++) {
+		ramdCache[i].data = (u8*)malloc(RAMD_GROUP_SIZE);
+		ramdCache[i].valid = false;
+		success &= ramdCache[i].data != NULL;
+	}
+
+	if(!success)
+		ramd_compressed_free();
+	return success;
+}
+
+void ramd_compression_stats(u64 *storedBytes, u64 *physicalBytes, u64 *poolBytes) {
+	ramd_flush();
+
+	u32 groups = 0;
+	for(u32 i = 0; i < ramdGroupCount; i++) {
+		if(ramdGroups[i].blockCount > 0)
+			groups++;
+	}
+
+	*storedBytes = (u64)groups * RAMD_GROUP_SIZE;
+	*physicalBytes = (u64)ramdBlocksUsed * SECTOR_SIZE;
+	*poolBytes = (u64)ramdPhysicalSectors * SECTOR_SIZE;
+}
+
+bool ramd_read_sectors(sec_t sector, sec_t numSectors, void *buffer) {
+	if(ramdCompressed)
+		return ramd_compressed_read_sectors(sector, numSectors, buffer);
+
+	return ramd_raw_read_sectors(sector, numSectors, buffer);
+}
+
+bool ramd_write_sectors(sec_t sector, sec_t numSectors, const void *buffer) {
+	if(ramdCompressed)
+		return ramd_compressed_write_sectors(sector, numSectors, buffer);
+
+	return ramd_raw_write_sectors(sector, numSectors, buffer);
+}
+
+// Snapshots hold only the sectors the FAT says are in use, as runs of
+// {u32 start, u32 count, data} after a header, ending with an empty run
+typedef struct {
+	char magic[8];
+	u32 sectors;
+	u32 reserved;
+} RamdSnapshotHeader;
+
+#define RAMD_SNAPSHOT_MAGIC "GM9iRAMD"
+#define RAMD_SNAPSHOT_CHUNK 32
+
+static bool ramd_snapshot_run(FILE *file, u8 *buffer, u32 start, u32 count) {
+	u32 run[2] = {start, count};
+	if(fwrite(run, sizeof(run), 1, file) != 1)
+		return false;
+
+	while(count > 0) {
+		u32 chunk = count < RAMD_SNAPSHOT_CHUNK ? count : RAMD_SNAPSHOT_CHUNK;
+		if(!ramd_read_sectors(start, chunk, buffer) || fwrite(buffer, SECTOR_SIZE, chunk, file) != chunk)
+			return false;
+
+		start += chunk;
+		count -= chunk;
 	}
 
 	return true;
 }
 
+static bool ramd_snapshot_runs(FILE *file, u8 *buffer) {
+	if(!ramd_read_sectors(0, 1, buffer))
+		return false;
+
+	u32 clusterSectors = buffer[0x0D];
+	u32 reservedSectors = buffer[0x0E] | buffer[0x0F] << 8;
+	u32 fatCount = buffer[0x10];
+	u32 rootSectors = ((buffer[0x11] | buffer[0x12] << 8) * 32 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+	u32 fatSectors = buffer[0x16] | buffer[0x17] << 8;
+	u32 dataStart = reservedSectors + fatCount * fatSectors + rootSectors;
+	if(clusterSectors == 0 || dataStart >= ramdSectors)
+		return false;
+
+	u32 clusters = (ramdSectors - dataStart) / clusterSectors;
+	bool fat12 = clusters < 4085;
+
+	// Don't trust the FAT to cover the whole volume
+	u32 fatEntries = fat12 ? fatSectors * SECTOR_SIZE * 2 / 3 : fatSectors * SECTOR_SIZE / 2;
+	if(fatEntries <= 2)
+		return false;
+	if(clusters > fatEntries - 2)
+		clusters = fatEntries - 2;
+
+	u8 *fat = (u8*)malloc(fatSectors * SECTOR_SIZE);
+	if(!fat)
+		return false;
+
+	bool success = ramd_read_sectors(reservedSectors, fatSectors, fat);
+
+	// Everything up to the data area always goes in, then each run of
+	// clusters that's allocated
+	u32 runStart = 0, runEnd = dataStart;
+	for(u32 cluster = 2; success && cluster < clusters + 2; cluster++) {
+		u32 entry;
+		if(fat12) {
+			u32 offset = cluster + cluster / 2;
+			entry = fat[offset] | fat[offset + 1] << 8;
+			entry = (cluster & 1) ? entry >> 4 : entry & 0xFFF;
+		} else {
+			entry = fat[cluster * 2] | fat[cluster * 2 + 1] << 8;
+		}
+
+		if(entry == 0)
+			continue;
+
+		u32 sector = dataStart + (cluster - 2) * clusterSectors;
+		if(sector != runEnd) {
+			success = ramd_snapshot_run(file, buffer, runStart, runEnd - runStart);
+			runStart = sector;
+		}
+		runEnd = sector + clusterSectors;
+	}
+
+	free(fat);
+	return success && ramd_snapshot_run(file, buffer, runStart, runEnd - runStart)
+		&& ramd_snapshot_run(file, buffer, 0, 0);
+}
+
+bool ramd_snapshot_save(FILE *file) {
+	RamdSnapshotHeader header = {RAMD_SNAPSHOT_MAGIC, ramdSectors, 0};
+	if(fwrite(&header, sizeof(header), 1, file) != 1)
+		return false;
+
+	u8 *buffer = (u8*)malloc(RAMD_SNAPSHOT_CHUNK * SECTOR_SIZE);
+	if(!buffer)
+		return false;
+
+	bool success = ramd_snapshot_runs(file, buffer);
+	free(buffer);
+	return success;
+}
+
+bool ramd_snapshot_fits(FILE *file) {
+	RamdSnapshotHeader header;
+	bool fits = fread(&header, sizeof(header), 1, file) == 1
+		&& memcmp(header.magic, RAMD_SNAPSHOT_MAGIC, sizeof(header.magic)) == 0
+		&& header.sectors == ramdSectors;
+
+	rewind(file);
+	return fits;
+}
+
+static bool ramd_snapshot_load(FILE *file) {
+	RamdSnapshotHeader header;
+	if(fread(&header, sizeof(header), 1, file) != 1
+	 || memcmp(header.magic, RAMD_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+	 || header.sectors != ramdSectors)
+		return false;
+
+	u8 *buffer = (u8*)malloc(RAMD_SNAPSHOT_CHUNK * SECTOR_SIZE);
+	if(!buffer)
+		return false;
+
+	bool success = false;
+	u32 run[2];
+	while(fread(run, sizeof(run), 1, file) == 1) {
+		u32 start = run[0], count = run[1];
+		if(count == 0) {
+			success = true;
+			break;
+		}
+		if(start + count > ramdSectors || start + count < start)
+			break;
+
+		while(count > 0) {
+			u32 chunk = count < RAMD_SNAPSHOT_CHUNK ? count : RAMD_SNAPSHOT_CHUNK;
+			if(fread(buffer, SECTOR_SIZE, chunk, file) != chunk || !ramd_write_sectors(start, chunk, buffer))
+				break;
+
+			start += chunk;
+			count -= chunk;
+		}
+		if(count > 0)
+			break;
+	}
+
+	free(buffer);
+	return success;
+}
+
+void ramd_snapshot_restore(FILE *file) {
+	ramdRestoreFile = file;
+	ramdRestoreSucceeded = false;
+}
+
+bool ramd_snapshot_restored(void) {
+	return ramdRestoreSucceeded;
+}
+
 bool ramd_clear_status() {
 	return true;
 }
 
 bool ramd_shutdown() {
+	ramd_compressed_free();
 	if(ramdLoc) {
 		free(ramdLoc);
 		ramdLoc = NULL;
@@ -3,8 +3,39 @@
 #include <nds.h>
 #include <nds/ndstypes.h>
 #include <nds/disc_io.h>
+#include <stdio.h>
+
+// How many times the RAM pool the compressed drive advertises
+#define RAMD_COMPRESS_RATIO 2
 
 extern u32 ramdSectors;
 extern u8* ramdLocMep;
+extern bool ramdCompressed;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Writes cached groups of the compressed drive back to the pool
+bool ramd_flush(void);
+
+// Bytes of non-zero data on the compressed drive, bytes of RAM they take
+// up and the total RAM in the pool
+void ramd_compression_stats(u64 *storedBytes, u64 *physicalBytes, u64 *poolBytes);
+
+// Streams the drive's used sectors to a snapshot file
+bool ramd_snapshot_save(FILE *file);
+
+// Whether a snapshot was taken from a drive the same size as this one
+bool ramd_snapshot_fits(FILE *file);
+
+// Loads the snapshot instead of formatting on the next mount, the file
+// has to stay open until then
+void ramd_snapshot_restore(FILE *file);
+bool ramd_snapshot_restored(void);
+
+#ifdef __cplusplus
+}
+#endif
 
 extern const DISC_INTERFACE io_ram_drive;
@@ -1,6 +1,5 @@
 #include "screenshot.h"
 
-#include "bmp.h"
 #include "date.h"
 #include "driveOperations.h"
 #include "file_browse.h"
@@ -10,85 +9,291 @@
 #include <fat.h>
 #include <nds.h>
 #include <stdio.h>
+#include <string.h>
 
-void wait();
+// Both screens go into one 256x384 PNG, top screen first. Each screen is
+// captured to VRAM D and encoded a row at a time straight into IDAT chunks,
+// so only a couple of rows and one chunk are ever buffered.
+//
+// The deflate stream is a single fixed Huffman block that only looks for
+// runs (distance 1 matches). That's cheap and after the row filters the UI
+// screens are mostly long runs of zeros anyway.
 
-void write16(void *address, u16 value) {
+#define SHOT_WIDTH 256
+#define SHOT_HEIGHT (192 * 2)
+#define ROW_BYTES (SHOT_WIDTH * 3)
+#define IDAT_SIZE 0x2000
 
-	u8* first = (u8*)address;
-	u8* second = first + 1;
+#define DEFLATE_MAX_RUN 258
 
-	*first = value & 0xff;
-	*second = value >> 8;
+static const u16 lengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const u8 lengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static u32 crcTable[256];
+static u16 fixedCodes[288]; // already bit reversed
+static u8 fixedLengths[288];
+static bool tablesReady = false;
+
+static FILE *pngFile;
+static bool pngError;
+
+static u8 rows[2][ROW_BYTES];
+static u8 filtered[3][1 + ROW_BYTES]; // none, sub, up
+static int currentRow;
+
+static u8 chunk[IDAT_SIZE] __attribute__((aligned(32)));
+static u32 chunkLen;
+static u32 bitBuf;
+static u32 bitCount;
+static u32 adlerA, adlerB;
+static int runByte; // -1 before the first byte
+static u32 runLen;
+
+static void makeTables(void) {
+	for (u32 i = 0; i < 256; i++) {
+		u32 crc = i;
+		for (int j = 0; j < 8; j++)
+			crc = (crc & 1) ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+		crcTable[i] = crc;
+	}
+
+	for (u32 sym = 0; sym < 288; sym++) {
+		u32 code, len;
+		if (sym < 144) {
+			code = 0x30 + sym;
+			len = 8;
+		} else if (sym < 256) {
+			code = 0x190 + sym - 144;
+			len = 9;
+		} else if (sym < 280) {
+			code = sym - 256;
+			len = 7;
+		} else {
+			code = 0xC0 + sym - 280;
+			len = 8;
+		}
+
+		// Huffman codes are sent most significant bit first
+		u32 reversed = 0;
+		for (u32 i = 0; i < len; i++)
+			reversed |= ((code >> i) & 1) << (len - 1 - i);
+		fixedCodes[sym] = reversed;
+		fixedLengths[sym] = len;
+	}
+
+	tablesReady = true;
+}
+
+static u32 crc32Update(u32 crc, const u8 *data, u32 len) {
+	while (len--)
+		crc = crcTable[(crc ^ *(data++)) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+static void writeBE32(u8 *dst, u32 value) {
+	dst[0] = value >> 24;
+	dst[1] = value >> 16;
+	dst[2] = value >> 8;
+	dst[3] = value;
+}
+
+static void pngWriteChunk(const char *type, const u8 *data, u32 len) {
+	u8 header[8], footer[4];
+	writeBE32(header, len);
+	memcpy(header + 4, type, 4);
+	writeBE32(footer, crc32Update(crc32Update(0xFFFFFFFF, header + 4, 4), data, len) ^ 0xFFFFFFFF);
+
+	DC_FlushRange(data, len);
+	if (fwrite(header, 1, 8, pngFile) != 8
+	 || (len > 0 && fwrite(data, 1, len, pngFile) != len)
+	 || fwrite(footer, 1, 4, pngFile) != 4)
+		pngError = true;
+}
+
+static void putByte(u8 byte) {
+	chunk[chunkLen++] = byte;
+	if (chunkLen == IDAT_SIZE) {
+		pngWriteChunk("IDAT", chunk, chunkLen);
+		chunkLen = 0;
+	}
+}
+
+static void putBits(u32 value, u32 count) {
+	bitBuf |= value << bitCount;
+	bitCount += count;
+	while (bitCount >= 8) {
+		putByte(bitBuf & 0xFF);
+		bitBuf >>= 8;
+		bitCount -= 8;
+	}
 }
 
-void write32(void *address, u32 value) {
+static inline void putSymbol(u32 sym) {
+	putBits(fixedCodes[sym], fixedLengths[sym]);
+}
+
+static void deflateFlushRun(void) {
+	if (runLen >= 3) {
+		int i = 28;
+		while (lengthBase[i] > runLen)
+			i--;
+		putSymbol(257 + i);
+		putBits(runLen - lengthBase[i], lengthExtra[i]);
+		putBits(0, 5); // distance code 0, a distance of 1
+	} else {
+		for (u32 i = 0; i < runLen; i++)
+			putSymbol(runByte);
+	}
+	runLen = 0;
+}
 
-	u8* first = (u8*)address;
-	u8* second = first + 1;
-	u8* third = first + 2;
-	u8* fourth = first + 3;
+static void deflateBytes(const u8 *data, u32 len) {
+	for (u32 i = 0; i < len; i++) {
+		u8 byte = data[i];
+		adlerA += byte;
+		adlerB += adlerA;
+
+		if (byte == runByte) {
+			if (++runLen == DEFLATE_MAX_RUN)
+				deflateFlushRun();
+			continue;
+		}
+
+		deflateFlushRun();
+		putSymbol(byte);
+		runByte = byte;
+	}
 
-	*first = value & 0xff;
-	*second = (value >> 8) & 0xff;
-	*third = (value >> 16) & 0xff;
-	*fourth = (value >> 24) & 0xff;
+	// At most a row at a time, so this can't overflow before it's reduced
+	adlerA %= 65521;
+	adlerB %= 65521;
 }
 
-bool screenshotbmp(const char* filename) {
-	FILE *file = fopen(filename, "wb");
+static void pngEncodeRow(void) {
+	const u8 *row = rows[currentRow];
+	const u8 *prev = rows[currentRow ^ 1];
 
-	if(!file)
+	// Take whichever filter leaves the smallest values, the usual heuristic
+	u32 sums[3] = {0, 0, 0};
+	for (int i = 0; i < ROW_BYTES; i++) {
+		u8 left = i >= 3 ? row[i - 3] : 0;
+		filtered[0][1 + i] = row[i];
+		filtered[1][1 + i] = row[i] - left;
+		filtered[2][1 + i] = row[i] - prev[i];
+
+		for (int f = 0; f < 3; f++) {
+			s8 value = filtered[f][1 + i];
+			sums[f] += value < 0 ? -value : value;
+		}
+	}
+
+	int best = 0;
+	for (int f = 1; f < 3; f++) {
+		if (sums[f] < sums[best])
+			best = f;
+	}
+
+	filtered[best][0] = best;
+	deflateBytes(filtered[best], 1 + ROW_BYTES);
+	currentRow ^= 1;
+}
+
+static bool pngOpen(const char *filename) {
+	pngFile = fopen(filename, "wb");
+	if (!pngFile)
 		return false;
 
-	REG_DISPCAPCNT = DCAP_BANK(DCAP_BANK_VRAM_D) | DCAP_SIZE(DCAP_SIZE_256x192) | DCAP_ENABLE;
-	while(REG_DISPCAPCNT & DCAP_ENABLE);
+	if (!tablesReady)
+		makeTables();
+
+	pngError = false;
+	memset(rows, 0, sizeof(rows));
+	currentRow = 0;
+	chunkLen = 0;
+	bitBuf = 0;
+	bitCount = 0;
+	adlerA = 1;
+	adlerB = 0;
+	runByte = -1;
+	runLen = 0;
+
+	static const u8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	if (fwrite(signature, 1, sizeof(signature), pngFile) != sizeof(signature))
+		pngError = true;
 
-	u8* temp = new u8[256 * 192 * 2 + sizeof(INFOHEADER) + sizeof(HEADER)];
+	u8 ihdr[13];
+	writeBE32(ihdr, SHOT_WIDTH);
+	writeBE32(ihdr + 4, SHOT_HEIGHT);
+	ihdr[8] = 8; // bits per channel
+	ihdr[9] = 2; // RGB
+	ihdr[10] = 0; // deflate
+	ihdr[11] = 0; // adaptive filtering
+	ihdr[12] = 0; // not interlaced
+	pngWriteChunk("IHDR", ihdr, sizeof(ihdr));
 
-	if(!temp) {
-		fclose(file);
+	// zlib header for deflate with a 32 KB window, then the only block:
+	// final, fixed Huffman codes
+	putByte(0x78);
+	putByte(0x01);
+	putBits(1, 1);
+	putBits(1, 2);
+
+	if (pngError) {
+		fclose(pngFile);
+		pngFile = NULL;
 		return false;
 	}
 
-	HEADER *header= (HEADER*)temp;
-	INFOHEADER *infoheader = (INFOHEADER*)(temp + sizeof(HEADER));
-
-	write16(&header->type, 0x4D42);
-	write32(&header->size, 256 * 192 * 2 + sizeof(INFOHEADER) + sizeof(HEADER));
-	write32(&header->reserved1, 0);
-	write32(&header->reserved2, 0);
-	write32(&header->offset, sizeof(INFOHEADER) + sizeof(HEADER));
-
-	write32(&infoheader->size, sizeof(INFOHEADER));
-	write32(&infoheader->width, 256);
-	write32(&infoheader->height, 192);
-	write16(&infoheader->planes, 1);
-	write16(&infoheader->bits, 16);
-	write32(&infoheader->compression, 3);
-	write32(&infoheader->imagesize, 256 * 192 * 2);
-	write32(&infoheader->xresolution, 2835);
-	write32(&infoheader->yresolution, 2835);
-	write32(&infoheader->ncolours, 0);
-	write32(&infoheader->importantcolours, 0);
-	write32(&infoheader->redBitmask, 0xF800);
-	write32(&infoheader->greenBitmask, 0x07E0);
-	write32(&infoheader->blueBitmask, 0x001F);
-	write32(&infoheader->reserved, 0);
-
-	u16 *ptr = (u16*)(temp + sizeof(HEADER) + sizeof(INFOHEADER));
-	for(int y = 0; y < 192; y++) {
-		for(int x = 0; x < 256; x++) {
-			u16 color = VRAM_D[256 * 191 - y * 256 + x];
-			*(ptr++) = ((color >> 10) & 0x1F) | (color & (0x1F << 5)) << 1 | ((color & 0x1F) << 11);
+	return true;
+}
+
+// Captures the main engine into VRAM D and encodes it as the next 192 rows
+static void pngCaptureScreen(void) {
+	REG_DISPCAPCNT = DCAP_BANK(DCAP_BANK_VRAM_D) | DCAP_SIZE(DCAP_SIZE_256x192) | DCAP_ENABLE;
+	while(REG_DISPCAPCNT & DCAP_ENABLE);
+
+	for (int y = 0; y < 192; y++) {
+		const u16 *src = VRAM_D + y * SHOT_WIDTH;
+		u8 *dst = rows[currentRow];
+		for (int x = 0; x < SHOT_WIDTH; x++) {
+			u16 color = src[x];
+			u8 r = color & 0x1F, g = (color >> 5) & 0x1F, b = (color >> 10) & 0x1F;
+			*(dst++) = r << 3 | r >> 2;
+			*(dst++) = g << 3 | g >> 2;
+			*(dst++) = b << 3 | b >> 2;
 		}
+
+		pngEncodeRow();
 	}
+}
 
-	DC_FlushAll();
-	fwrite(temp, 1, 256 * 192 * 2 + sizeof(INFOHEADER) + sizeof(HEADER), file);
-	fclose(file);
-	delete[] temp;
-	return true;
+static bool pngClose(void) {
+	deflateFlushRun();
+	putSymbol(256); // end of block
+	if (bitCount > 0)
+		putBits(0, 8 - bitCount);
+
+	u32 adler = (adlerB << 16) | adlerA;
+	putByte(adler >> 24);
+	putByte(adler >> 16);
+	putByte(adler >> 8);
+	putByte(adler);
+
+	if (chunkLen > 0)
+		pngWriteChunk("IDAT", chunk, chunkLen);
+	pngWriteChunk("IEND", NULL, 0);
+
+	bool success = !pngError;
+	if (fclose(pngFile) != 0)
+		success = false;
+	pngFile = NULL;
+	return success;
 }
 
 bool screenshot(void) {
@@ -105,11 +310,13 @@ bool screenshot(void) {
 
 	std::string fileTimeText = RetTime("%H%M%S");
 	char snapPath[40];
-	// Take top screenshot
-	snprintf(snapPath, sizeof(snapPath), "%s:/gm9i/out/snap_%s_top.bmp", (sdWritable ? "sd" : "fat"), fileTimeText.c_str());
-	if(!screenshotbmp(snapPath))
+	snprintf(snapPath, sizeof(snapPath), "%s:/gm9i/out/snap_%s.png", (sdWritable ? "sd" : "fat"), fileTimeText.c_str());
+	if(!pngOpen(snapPath))
 		return false;
 
+	// Take top screenshot
+	pngCaptureScreen();
+
 	// Seamlessly swap top and bottom screens
 	font->mainOnTop(false);
 	font->update(false);
@@ -117,14 +324,12 @@ bool screenshot(void) {
 	lcdMainOnBottom();
 
 	// Take bottom screenshot
-	snprintf(snapPath, sizeof(snapPath), "%s:/gm9i/out/snap_%s_bot.bmp", (sdWritable ? "sd" : "fat"), fileTimeText.c_str());
-	if(!screenshotbmp(snapPath))
-		return false;
+	pngCaptureScreen();
 
 	font->mainOnTop(true);
 	font->update(true);
 	font->update(false);
 	lcdMainOnTop();
 
-	return true;
-}
\ No newline at end of file
+	return pngClose();
+}
@@ -1,5 +1,6 @@
 #include "titleManager.h"
 #include "config.h"
+#include "date.h"
 #include "driveOperations.h"
 #include "file_browse.h"
 #include "fileOperations.h"
@@ -7,10 +8,13 @@
 #include "language.h"
 #include "main.h"
 #include "screenshot.h"
+#include "sha1.h"
 
 #include <algorithm>
 #include <dirent.h>
 #include <nds.h>
+#include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 #include <vector>
 
@@ -27,6 +31,7 @@ struct TitleInfo {
 	u8 appVersion[4];
 	u8 romVersion;
 	std::u16string bannerTitle;
+	bool selected = false;
 };
 
 enum TitleDumpOption {
@@ -39,31 +44,216 @@ enum TitleDumpOption {
 	all = rom | publicSave | privateSave | bannerSave | tmd
 };
 
-void dumpTitle(TitleInfo &title) {
-	u16 pressed = 0, held = 0;
-	int optionOffset = 0;
+struct TitleDumpJob {
+	TitleDumpJob(std::string inpath, std::string outpath, std::string name, off_t size) : inpath(std::move(inpath)), outpath(std::move(outpath)), name(std::move(name)), size(size) {}
 
-	std::vector<TitleDumpOption> allowedOptions({TitleDumpOption::all, TitleDumpOption::rom});
-	u8 allowedBitfield = TitleDumpOption::rom | TitleDumpOption::tmd;
-	if(access((title.path + "/data/public.sav").c_str(), F_OK) == 0) {
-		allowedOptions.push_back(TitleDumpOption::publicSave);
-		allowedBitfield |= TitleDumpOption::publicSave;
+	std::string inpath;
+	std::string outpath;
+	std::string name;
+	off_t size;
+};
+
+static std::string titleDumpName(const TitleInfo &title) {
+	char dumpName[32];
+	snprintf(dumpName, sizeof(dumpName), "%s_%s_%02X", title.gameTitle, title.gameCode, title.romVersion);
+	return dumpName;
+}
+
+/**
+ * Adds a job for each component of the title that is both selected and present.
+ * Missing components (such as saves the title doesn't use) are skipped.
+ */
+static void queueTitleDump(std::vector<TitleDumpJob> &jobs, const TitleInfo &title, TitleDumpOption option) {
+	const char *outDrive = sdMounted ? "sd" : "fat";
+	std::string dumpName = titleDumpName(title);
+
+	char appName[16];
+	snprintf(appName, sizeof(appName), "%02x%02x%02x%02x.app", title.appVersion[0], title.appVersion[1], title.appVersion[2], title.appVersion[3]);
+
+	const struct {
+		TitleDumpOption option;
+		std::string inpath;
+		const char *extension;
+	} components[] = {
+		{TitleDumpOption::rom, title.path + "/content/" + appName, "nds"},
+		{TitleDumpOption::publicSave, title.path + "/data/public.sav", "pub"},
+		{TitleDumpOption::privateSave, title.path + "/data/private.sav", "prv"},
+		{TitleDumpOption::bannerSave, title.path + "/data/banner.sav", "bnr"},
+		{TitleDumpOption::tmd, title.path + "/content/title.tmd", "tmd"},
+	};
+
+	for(const auto &component : components) {
+		if(!(option & component.option))
+			continue;
+
+		struct stat st;
+		if(stat(component.inpath.c_str(), &st) != 0)
+			continue;
+
+		char outpath[64];
+		snprintf(outpath, sizeof(outpath), "%s:/gm9i/out/%s.%s", outDrive, dumpName.c_str(), component.extension);
+		jobs.emplace_back(component.inpath, outpath, dumpName + "." + component.extension, st.st_size);
 	}
-	if(access((title.path + "/data/private.sav").c_str(), F_OK) == 0) {
-		allowedOptions.push_back(TitleDumpOption::privateSave);
-		allowedBitfield |= TitleDumpOption::privateSave;
+}
+
+static void titleDumpMessage(const char *msg) {
+	font->clear(false);
+	font->print(firstCol, 0, false, std::string(msg) + "\n\n" + STR_A_OK, alignStart);
+	font->update(false);
+
+	do {
+		swiWaitForVBlank();
+		scanKeys();
+	} while(!(keysDown() & KEY_A));
+}
+
+static void titleDumpFailMsg(const std::string &name) {
+	char msg[256];
+	snprintf(msg, sizeof(msg), STR_FAILED_TO_DUMP_X.c_str(), name.c_str());
+	titleDumpMessage(msg);
+}
+
+/**
+ * Copies a queue of title components to /gm9i/out with one aggregate progress screen,
+ * hashing each file as it's written and recording the hashes in a manifest.
+ */
+static void dumpTitles(const std::vector<const TitleInfo *> &titles, TitleDumpOption option) {
+	const char *outDrive = sdMounted ? "sd" : "fat";
+
+	std::vector<TitleDumpJob> jobs;
+	for(const TitleInfo *title : titles)
+		queueTitleDump(jobs, *title, option);
+
+	if(jobs.empty())
+		return;
+
+	// Check once that everything will fit
+	u64 totalSize = 0;
+	for(const TitleDumpJob &job : jobs)
+		totalSize += job.size;
+
+	u64 freeSpace = driveSizeFree(sdMounted ? Drive::sdCard : Drive::flashcard);
+	if(totalSize > freeSpace) {
+		char msg[256];
+		snprintf(msg, sizeof(msg), STR_TITLES_TOO_BIG.c_str(), getBytes(totalSize).c_str(), getBytes(freeSpace).c_str());
+		titleDumpMessage(msg);
+		return;
 	}
-	if(access((title.path + "/data/banner.sav").c_str(), F_OK) == 0) {
-		allowedOptions.push_back(TitleDumpOption::bannerSave);
-		allowedBitfield |= TitleDumpOption::bannerSave;
+
+	// Ensure directories exist
+	char folderPath[16];
+	sprintf(folderPath, "%s:/gm9i", outDrive);
+	if (access(folderPath, F_OK) != 0) {
+		font->clear(false);
+		font->print(firstCol, 0, false, STR_CREATING_DIRECTORY, alignStart);
+		font->update(false);
+		mkdir(folderPath, 0777);
+	}
+	sprintf(folderPath, "%s:/gm9i/out", outDrive);
+	if (access(folderPath, F_OK) != 0) {
+		font->clear(false);
+		font->print(firstCol, 0, false, STR_CREATING_DIRECTORY, alignStart);
+		font->update(false);
+		mkdir(folderPath, 0777);
 	}
-	allowedOptions.push_back(TitleDumpOption::tmd);
 
-	char dumpName[32];
-	snprintf(dumpName, sizeof(dumpName), "%s_%s_%02X", title.gameTitle, title.gameCode, title.romVersion);
+	char manifestPath[64];
+	if(titles.size() == 1)
+		snprintf(manifestPath, sizeof(manifestPath), "%s:/gm9i/out/%s.sha1", outDrive, titleDumpName(*titles[0]).c_str());
+	else
+		snprintf(manifestPath, sizeof(manifestPath), "%s:/gm9i/out/titles_%s.sha1", outDrive, RetTime("%Y%m%d_%H%M%S").c_str());
+	FILE *manifest = fopen(manifestPath, "wb");
+	if(!manifest) {
+		titleDumpFailMsg(strrchr(manifestPath, '/') + 1);
+		return;
+	}
 
-	char dumpToStr[256];
-	snprintf(dumpToStr, sizeof(dumpToStr), STR_DUMP_TO.c_str(), dumpName, sdMounted ? "sd" : "fat");
+	u64 doneSize = 0;
+	time_t startTime = time(nullptr);
+
+	for(size_t i = 0; i < jobs.size(); i++) {
+		const TitleDumpJob &job = jobs[i];
+
+		FILE *sourceFile = fopen(job.inpath.c_str(), "rb");
+		FILE *destinationFile = sourceFile ? fopen(job.outpath.c_str(), "wb") : nullptr;
+		if(!destinationFile) {
+			if(sourceFile)
+				fclose(sourceFile);
+			fclose(manifest);
+			titleDumpFailMsg(job.name);
+			return;
+		}
+
+		SHA1_CTX ctx;
+		SHA1Init(&ctx);
+
+		for(int chunk = 0; ; chunk++) {
+			// Only redraw every 256 KiB, one screen for the whole queue
+			if((chunk % 8) == 0) {
+				font->clear(false);
+				font->printf(firstCol, 0, false, alignStart, Palette::white, STR_DUMPING_N_OF_N.c_str(), (int)i + 1, (int)jobs.size());
+				font->print(firstCol, 1, false, job.name, alignStart);
+
+				font->print(0, 3, false, "[");
+				font->print(-1, 3, false, "]");
+				int progressPos = totalSize ? (doneSize * (SCREEN_COLS - 2) / totalSize) + 1 : 1;
+				for(int pos = 1; pos <= progressPos; pos++)
+					font->print(rtl ? (pos + 1) * -1 : pos, 3, false, "=");
+
+				font->print(firstCol, 4, false, getBytes(doneSize) + " / " + getBytes(totalSize), alignStart);
+
+				time_t elapsed = time(nullptr) - startTime;
+				if(elapsed > 0 && doneSize > 0) {
+					u32 remaining = (totalSize - doneSize) * elapsed / doneSize;
+					font->printf(firstCol, 5, false, alignStart, Palette::white, STR_TIME_REMAINING.c_str(), remaining / 60, remaining % 60);
+				}
+
+				font->print(firstCol, 7, false, STR_B_CANCEL, alignStart);
+				font->update(false);
+			}
+
+			scanKeys();
+			if(keysHeld() & KEY_B) {
+				// Cancel dumping, don't leave a partial file behind
+				fclose(sourceFile);
+				fclose(destinationFile);
+				unlink(job.outpath.c_str());
+				fclose(manifest);
+				return;
+			}
+
+			size_t numr = fread(copyBuf, 1, copyBufSize, sourceFile);
+			if(numr == 0)
+				break;
+
+			SHA1Update(&ctx, copyBuf, numr);
+			if(fwrite(copyBuf, 1, numr, destinationFile) != numr) {
+				fclose(sourceFile);
+				fclose(destinationFile);
+				unlink(job.outpath.c_str());
+				fclose(manifest);
+				titleDumpFailMsg(job.name);
+				return;
+			}
+			doneSize += numr;
+		}
+
+		fclose(sourceFile);
+		fclose(destinationFile);
+
+		u8 sha1[20];
+		SHA1Final(sha1, &ctx);
+		for(int j = 0; j < 20; j++)
+			fprintf(manifest, "%02x", sha1[j]);
+		fprintf(manifest, "  %s\n", job.name.c_str());
+	}
+
+	fclose(manifest);
+}
+
+TitleDumpOption titleDumpMenu(const std::vector<TitleDumpOption> &allowedOptions, const char *dumpToStr) {
+	u16 pressed = 0, held = 0;
+	int optionOffset = 0;
 
 	int y = font->calcHeight(dumpToStr) + 1;
 
@@ -126,63 +316,11 @@ void dumpTitle(TitleInfo &title) {
 		if (optionOffset >= (int)allowedOptions.size()) // Wrap around to top of list
 			optionOffset = 0;
 
-		if (pressed & KEY_A) {
-			TitleDumpOption selectedOption = allowedOptions[optionOffset];
-
-			// Ensure directories exist
-			char folderPath[16];
-			sprintf(folderPath, "%s:/gm9i", (sdMounted ? "sd" : "fat"));
-			if (access(folderPath, F_OK) != 0) {
-				font->clear(false);
-				font->print(firstCol, 0, false, STR_CREATING_DIRECTORY, alignStart);
-				font->update(false);
-				mkdir(folderPath, 0777);
-			}
-			sprintf(folderPath, "%s:/gm9i/out", (sdMounted ? "sd" : "fat"));
-			if (access(folderPath, F_OK) != 0) {
-				font->clear(false);
-				font->print(firstCol, 0, false, STR_CREATING_DIRECTORY, alignStart);
-				font->update(false);
-				mkdir(folderPath, 0777);
-			}
-
-			// Dump to /gm9i/out
-			char inpath[64], outpath[64];
-			if((selectedOption & TitleDumpOption::rom) && (allowedBitfield & TitleDumpOption::rom)) {
-				snprintf(inpath, sizeof(inpath), "%s/content/%02x%02x%02x%02x.app", title.path.c_str(), title.appVersion[0], title.appVersion[1], title.appVersion[2], title.appVersion[3]);
-				snprintf(outpath, sizeof(outpath), "%s:/gm9i/out/%s.nds", sdMounted ? "sd" : "fat", dumpName);
-				fcopy(inpath, outpath);
-			}
-
-			if((selectedOption & TitleDumpOption::publicSave) && (allowedBitfield & TitleDumpOption::publicSave)) {
-				snprintf(inpath, sizeof(inpath), "%s/data/public.sav", title.path.c_str());
-				snprintf(outpath, sizeof(outpath), "%s:/gm9i/out/%s.pub", sdMounted ? "sd" : "fat", dumpName);
-				fcopy(inpath, outpath);
-			}
-
-			if((selectedOption & TitleDumpOption::privateSave) && (allowedBitfield & TitleDumpOption::privateSave)) {
-				snprintf(inpath, sizeof(inpath), "%s/data/private.sav", title.path.c_str());
-				snprintf(outpath, sizeof(outpath), "%s:/gm9i/out/%s.prv", sdMounted ? "sd" : "fat", dumpName);
-				fcopy(inpath, outpath);
-			}
-
-			if((selectedOption & TitleDumpOption::bannerSave) && (allowedBitfield & TitleDumpOption::bannerSave)) {
-				snprintf(inpath, sizeof(inpath), "%s/data/banner.sav", title.path.c_str());
-				snprintf(outpath, sizeof(outpath), "%s:/gm9i/out/%s.bnr", sdMounted ? "sd" : "fat", dumpName);
-				fcopy(inpath, outpath);
-			}
-
-			if((selectedOption & TitleDumpOption::tmd) && (allowedBitfield & TitleDumpOption::tmd)) {
-				snprintf(inpath, sizeof(inpath), "%s/content/title.tmd", title.path.c_str());
-				snprintf(outpath, sizeof(outpath), "%s:/gm9i/out/%s.tmd", sdMounted ? "sd" : "fat", dumpName);
-				fcopy(inpath, outpath);
-			}
-
-			return;
-		}
+		if (pressed & KEY_A)
+			return allowedOptions[optionOffset];
 
 		if (pressed & KEY_B)
-			return;
+			return TitleDumpOption::none;
 
 		// Swap screens
 		if (pressed & config->screenSwapKey()) {
@@ -197,6 +335,44 @@ void dumpTitle(TitleInfo &title) {
 	}
 }
 
+void dumpTitle(TitleInfo &title) {
+	std::vector<TitleDumpOption> allowedOptions({TitleDumpOption::all, TitleDumpOption::rom});
+	if(access((title.path + "/data/public.sav").c_str(), F_OK) == 0)
+		allowedOptions.push_back(TitleDumpOption::publicSave);
+	if(access((title.path + "/data/private.sav").c_str(), F_OK) == 0)
+		allowedOptions.push_back(TitleDumpOption::privateSave);
+	if(access((title.path + "/data/banner.sav").c_str(), F_OK) == 0)
+		allowedOptions.push_back(TitleDumpOption::bannerSave);
+	allowedOptions.push_back(TitleDumpOption::tmd);
+
+	char dumpToStr[256];
+	snprintf(dumpToStr, sizeof(dumpToStr), STR_DUMP_TO.c_str(), titleDumpName(title).c_str(), sdMounted ? "sd" : "fat");
+
+	TitleDumpOption option = titleDumpMenu(allowedOptions, dumpToStr);
+	if(option != TitleDumpOption::none)
+		dumpTitles({&title}, option);
+}
+
+void dumpSelectedTitles(std::vector<TitleInfo> &titles) {
+	std::vector<const TitleInfo *> selected;
+	for(const TitleInfo &title : titles) {
+		if(title.selected)
+			selected.push_back(&title);
+	}
+
+	char dumpToStr[256];
+	snprintf(dumpToStr, sizeof(dumpToStr), STR_DUMP_N_TITLES_TO.c_str(), selected.size(), sdMounted ? "sd" : "fat");
+
+	TitleDumpOption option = titleDumpMenu({TitleDumpOption::all, TitleDumpOption::rom, TitleDumpOption::publicSave, TitleDumpOption::privateSave, TitleDumpOption::bannerSave, TitleDumpOption::tmd}, dumpToStr);
+	if(option == TitleDumpOption::none)
+		return;
+
+	dumpTitles(selected, option);
+
+	for(TitleInfo &title : titles)
+		title.selected = false;
+}
+
 void titleManager() {
 	if(!nandMounted || !(sdMounted || flashcardMounted))
 		return;
@@ -285,7 +461,7 @@ void titleManager() {
 
 		for(int i = 0; i < ((int)titles.size() - scrollOffset) && i < ENTRIES_PER_SCREEN; i++) {
 			const TitleInfo &title = titles[scrollOffset + i];
-			Palette pal = scrollOffset + i == cursorPosition ? Palette::white : Palette::gray;
+			Palette pal = title.selected ? Palette::yellow : (scrollOffset + i == cursorPosition ? Palette::white : Palette::gray);
 			font->print(firstCol, 1 + i, false, title.bannerTitle.substr(0, title.bannerTitle.find(u'\n')), alignStart, pal);
 			font->printf(lastCol, 1 + i, false, alignEnd, pal, rtl ? "(%s) " : " (%s)", title.gameCode);
 		}
@@ -315,8 +491,14 @@ void titleManager() {
 			cursorPosition += ENTRIES_PER_SCREEN;
 			if(cursorPosition > (int)titles.size() + 1)
 				cursorPosition = titles.size() - 1;
-		} else if(pressed & KEY_A) {
-			dumpTitle(titles[cursorPosition]);
+		} else if((pressed & KEY_L) && !(keysHeld() & KEY_R) && titles.size() > 0) {
+			// Add to selection, dumped together as one queue
+			titles[cursorPosition].selected = !titles[cursorPosition].selected;
+		} else if((pressed & KEY_A) && titles.size() > 0) {
+			if(std::any_of(titles.begin(), titles.end(), [](const TitleInfo &x) { return x.selected; }))
+				dumpSelectedTitles(titles);
+			else
+				dumpTitle(titles[cursorPosition]);
 		} else if(pressed & KEY_B) {
 			return;
 		}
@@ -202,6 +202,32 @@ enum {FS_UNKNOWN, FS_FAT12, FS_FAT16, FS_FAT32} discFileSystem;
 // Global sector buffer to save on stack space
 unsigned char globalBuffer[BYTES_PER_SECTOR];
 
+// The FAT sector last read, walking a chain mostly stays inside one
+unsigned char fatBuffer[BYTES_PER_SECTOR];
+u32 fatBufferSector = 0xFFFFFFFF;
+
+// The clusters of the file last read, as runs of consecutive clusters.
+// Built once per file so reads don't walk the chain from the start every
+// time, and can cover a whole run in one go
+#define FAT_RUN_MAX 256
+
+// Largest single read, the SD/MMC block counter is only 16 bits
+#define FAT_READ_MAX 0x4000
+
+typedef struct {
+	u32 cluster;
+	u32 length;
+} FAT_RUN;
+
+FAT_RUN fileRuns[FAT_RUN_MAX];
+int fileRunCount = 0;
+u32 fileRunStart = CLUSTER_FREE;
+// First cluster not in the list, for files in more than FAT_RUN_MAX pieces,
+// and how far past it the chain has been walked
+u32 fileRunNext = CLUSTER_EOF;
+u32 fileWalkIndex = 0;
+u32 fileWalkCluster = CLUSTER_EOF;
+
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //FAT routines
@@ -210,6 +236,19 @@ u32 FAT_ClustToSect (u32 cluster) {
 	return (((cluster-2) * discSecPerClus) + discData);
 }
 
+/*-----------------------------------------------------------------
+FAT_ReadFatSector
+Internal function - reads a sector of the FAT, unless it's already loaded
+-----------------------------------------------------------------*/
+unsigned char* FAT_ReadFatSector (u32 sector)
+{
+	if (sector != fatBufferSector) {
+		CARD_ReadSector(sector, fatBuffer);
+		fatBufferSector = sector;
+	}
+	return fatBuffer;
+}
+
 /*-----------------------------------------------------------------
 FAT_NextCluster
 Internal function - gets the cluster linked from input cluster
@@ -230,8 +269,7 @@ u32 FAT_NextCluster(u32 cluster)
 		case FS_FAT12:
 			sector = discFAT + (((cluster * 3) / 2) / BYTES_PER_SECTOR);
 			offset = ((cluster * 3) / 2) % BYTES_PER_SECTOR;
-			CARD_ReadSector(sector, globalBuffer);
-			nextCluster = ((u8*) globalBuffer)[offset];
+			nextCluster = FAT_ReadFatSector(sector)[offset];
 			offset++;
 			
 			if (offset >= BYTES_PER_SECTOR) {
@@ -239,8 +277,7 @@ u32 FAT_NextCluster(u32 cluster)
 				sector++;
 			}
 			
-			CARD_ReadSector(sector, globalBuffer);
-			nextCluster |= (((u8*) globalBuffer)[offset]) << 8;
+			nextCluster |= FAT_ReadFatSector(sector)[offset] << 8;
 			
 			if (cluster & 0x01) {
 				nextCluster = nextCluster >> 4;
@@ -248,15 +285,18 @@ u32 FAT_NextCluster(u32 cluster)
 				nextCluster &= 0x0FFF;
 			}
 			
+			if (nextCluster >= 0x0FF7) {
+				nextCluster = CLUSTER_EOF;
+			}
+			
 			break;
 			
 		case FS_FAT16:
 			sector = discFAT + ((cluster << 1) / BYTES_PER_SECTOR);
 			offset = cluster % (BYTES_PER_SECTOR >> 1);
 			
-			CARD_ReadSector(sector, globalBuffer);
 			// read the nextCluster value
-			nextCluster = ((u16*)globalBuffer)[offset];
+			nextCluster = ((u16*)FAT_ReadFatSector(sector))[offset];
 			
 			if (nextCluster >= 0xFFF7) {
 				nextCluster = CLUSTER_EOF;
@@ -267,9 +307,8 @@ u32 FAT_NextCluster(u32 cluster)
 			sector = discFAT + ((cluster << 2) / BYTES_PER_SECTOR);
 			offset = cluster % (BYTES_PER_SECTOR >> 2);
 			
-			CARD_ReadSector(sector, globalBuffer);
 			// read the nextCluster value
-			nextCluster = (((u32*)globalBuffer)[offset]) & 0x0FFFFFFF;
+			nextCluster = (((u32*)FAT_ReadFatSector(sector))[offset]) & 0x0FFFFFFF;
 			
 			if (nextCluster >= 0x0FFFFFF7) {
 				nextCluster = CLUSTER_EOF;
@@ -312,6 +351,10 @@ bool FAT_InitFiles (bool initCard)
 	if (initCard && !CARD_StartUp()) {
 		return (false);
 	}
+
+	// Could be a different card now
+	fatBufferSector = 0xFFFFFFFF;
+	fileRunStart = CLUSTER_FREE;
 	
 	// Read first sector of card
 	if (!CARD_ReadSector (0, globalBuffer)) 
@@ -467,13 +510,85 @@ u32 getBootFileCluster (const char* bootName)
 	return (dir.startCluster | (dir.startClusterHigh << 16));
 }
 
+/*-----------------------------------------------------------------
+FAT_BuildRuns
+Internal function - lists the runs of a file's cluster chain, unless
+it's the same file as last time
+-----------------------------------------------------------------*/
+void FAT_BuildRuns (u32 cluster)
+{
+	// Stops a corrupt chain that loops back on itself
+	u32 maxClusters = (discNumSec - discData) / discSecPerClus;
+	u32 walked = 0;
+
+	if (cluster == fileRunStart) {
+		return;
+	}
+
+	fileRunStart = cluster;
+	fileRunCount = 0;
+	fileRunNext = CLUSTER_EOF;
+	fileWalkIndex = 0;
+	fileWalkCluster = CLUSTER_EOF;
+
+	while (cluster >= CLUSTER_FIRST && cluster != CLUSTER_EOF && walked++ <= maxClusters) {
+		if (fileRunCount > 0 && fileRuns[fileRunCount - 1].cluster + fileRuns[fileRunCount - 1].length == cluster) {
+			fileRuns[fileRunCount - 1].length++;
+		} else if (fileRunCount < FAT_RUN_MAX) {
+			fileRuns[fileRunCount].cluster = cluster;
+			fileRuns[fileRunCount].length = 1;
+			fileRunCount++;
+		} else {
+			fileRunNext = cluster;
+			fileWalkCluster = cluster;
+			break;
+		}
+		cluster = FAT_NextCluster (cluster);
+	}
+}
+
+/*-----------------------------------------------------------------
+FAT_FindCluster
+Internal function - gets the file's index'th cluster, and how many
+clusters from there on are consecutive
+-----------------------------------------------------------------*/
+u32 FAT_FindCluster (u32 index, u32* contiguous)
+{
+	int i;
+	u32 cluster;
+
+	for (i = 0; i < fileRunCount; i++) {
+		if (index < fileRuns[i].length) {
+			*contiguous = fileRuns[i].length - index;
+			return fileRuns[i].cluster + index;
+		}
+		index -= fileRuns[i].length;
+	}
+
+	// Past the end of the list, walk the rest of the way. Reads mostly go
+	// forwards so carry on from the last walk if possible
+	if (index < fileWalkIndex) {
+		fileWalkIndex = 0;
+		fileWalkCluster = fileRunNext;
+	}
+	for (cluster = fileWalkCluster; fileWalkIndex < index && cluster >= CLUSTER_FIRST && cluster != CLUSTER_EOF; fileWalkIndex++) {
+		cluster = FAT_NextCluster (cluster);
+	}
+	fileWalkCluster = cluster;
+	*contiguous = 1;
+	return cluster;
+}
+
 /*-----------------------------------------------------------------
 fileRead(buffer, cluster, startOffset, length)
 -----------------------------------------------------------------*/
 u32 fileRead (char* buffer, u32 cluster, u32 startOffset, u32 length)
 {
 	int curByte;
-	int curSect;
+	u32 curSect;
+	u32 sectorsLeft;
+	u32 nextIndex;
+	u32 contiguous;
 	
 	int dataPos = 0;
 	int chunks;
@@ -484,19 +599,26 @@ u32 fileRead (char* buffer, u32 cluster, u32 startOffset, u32 length)
 		return 0;
 	}
 	
-	// Follow cluster list until desired one is found
-	for (chunks = startOffset / discBytePerClus; chunks > 0; chunks--) {
-		cluster = FAT_NextCluster (cluster);
+	FAT_BuildRuns (cluster);
+
+	// Find the cluster the read starts in
+	nextIndex = startOffset / discBytePerClus;
+	cluster = FAT_FindCluster (nextIndex, &contiguous);
+	if (cluster < CLUSTER_FIRST || cluster == CLUSTER_EOF) {
+		return 0;
 	}
+	nextIndex += contiguous;
 	
 	// Calculate the sector and byte of the current position,
 	// and store them
-	curSect = (startOffset % discBytePerClus) / BYTES_PER_SECTOR;
+	curSect = FAT_ClustToSect(cluster) + (startOffset % discBytePerClus) / BYTES_PER_SECTOR;
+	sectorsLeft = contiguous * discSecPerClus - (startOffset % discBytePerClus) / BYTES_PER_SECTOR;
 	curByte = startOffset % BYTES_PER_SECTOR;
 
 	// Load sector buffer for new position in file
-	CARD_ReadSector(curSect + FAT_ClustToSect(cluster), globalBuffer);
+	CARD_ReadSector(curSect, globalBuffer);
 	curSect++;
+	sectorsLeft--;
 
 	// Number of bytes needed to read to align with a sector
 	beginBytes = (BYTES_PER_SECTOR < length + curByte ? (BYTES_PER_SECTOR - curByte) : length);
@@ -508,23 +630,31 @@ u32 fileRead (char* buffer, u32 cluster, u32 startOffset, u32 length)
 
 	// Read in all the 512 byte chunks of the file directly, saving time
 	for (chunks = ((int)length - beginBytes) / BYTES_PER_SECTOR; chunks > 0;) {
-		int sectorsToRead;
+		u32 sectorsToRead;
 
-		// Move to the next cluster if necessary
-		if (curSect >= discSecPerClus) {
-			curSect = 0;
-			cluster = FAT_NextCluster (cluster);
+		// Move to the next run of clusters if necessary
+		if (sectorsLeft == 0) {
+			cluster = FAT_FindCluster (nextIndex, &contiguous);
+			if (cluster < CLUSTER_FIRST || cluster == CLUSTER_EOF) {
+				return dataPos;
+			}
+			nextIndex += contiguous;
+			curSect = FAT_ClustToSect(cluster);
+			sectorsLeft = contiguous * discSecPerClus;
 		}
 
-		// Calculate how many sectors to read (read a maximum of discSecPerClus at a time)
-		sectorsToRead = discSecPerClus - curSect;
-		if (chunks < sectorsToRead)
+		// Read as much of the run as is needed in one go
+		sectorsToRead = sectorsLeft;
+		if ((u32)chunks < sectorsToRead)
 			sectorsToRead = chunks;
+		if (sectorsToRead > FAT_READ_MAX)
+			sectorsToRead = FAT_READ_MAX;
 
 		// Read the sectors
-		CARD_ReadSectors(curSect + FAT_ClustToSect(cluster), sectorsToRead, buffer + dataPos);
+		CARD_ReadSectors(curSect, sectorsToRead, buffer + dataPos);
 		chunks  -= sectorsToRead;
 		curSect += sectorsToRead;
+		sectorsLeft -= sectorsToRead;
 		dataPos += BYTES_PER_SECTOR * sectorsToRead;
 	}
 
@@ -533,11 +663,14 @@ u32 fileRead (char* buffer, u32 cluster, u32 startOffset, u32 length)
 
 		// Update the read buffer
 		curByte = 0;
-		if (curSect >= discSecPerClus) {
-			curSect = 0;
-			cluster = FAT_NextCluster (cluster);
+		if (sectorsLeft == 0) {
+			cluster = FAT_FindCluster (nextIndex, &contiguous);
+			if (cluster < CLUSTER_FIRST || cluster == CLUSTER_EOF) {
+				return dataPos;
+			}
+			curSect = FAT_ClustToSect(cluster);
 		}
-		CARD_ReadSector(curSect + FAT_ClustToSect(cluster), globalBuffer);
+		CARD_ReadSector(curSect, globalBuffer);
 		
 		// Read in last partial chunk
 		for (; dataPos < length; dataPos++) {
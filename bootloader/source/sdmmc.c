@@ -1,10 +1,47 @@
 #ifndef NO_SDMMC
 #include <nds/bios.h>
 #include "sdmmc.h"
+#include "dmaTwl.h"
+#include "tonccpy.h"
 #include <stddef.h>
 
 static struct mmcdevice deviceSD;
 
+#ifdef DATA32_SUPPORT
+#define SDMMC_NDMA_CHANNEL 1
+
+// Unaligned buffers go through here a block at a time
+static u32 bounceBuf[512 / 4];
+
+//---------------------------------------------------------------------------------
+static void sdmmc_fifo_read(u32 *dst, u32 size) {
+//---------------------------------------------------------------------------------
+	// The whole block is already in the FIFO when this is called, and NDMA
+	// is always there as the SD card is only used in DSi mode
+	vu32* channel = &(&REG_NDMA0SAD)[7 * SDMMC_NDMA_CHANNEL];
+	channel[0] = SDMMC_BASE + REG_SDFIFO32; //SAD
+	channel[1] = (u32)dst; //DAD
+	channel[3] = size >> 2; //WCNT
+	channel[4] = NDMABCNT_PRESCALER_1 | NDMABCNT_INTERVAL(0); //BCNT
+	channel[6] = NDMACNT_DST_MODE_INCREMENT | NDMACNT_SRC_MODE_FIXED |
+		NDMACNT_PHYSICAL_COUNT_1 | NDMACNT_MODE_IMMEDIATE | NDMACNT_ENABLE;
+	dma_twlWait(SDMMC_NDMA_CHANNEL);
+}
+
+//---------------------------------------------------------------------------------
+static void sdmmc_fifo_write(const u32 *src, u32 size) {
+//---------------------------------------------------------------------------------
+	vu32* channel = &(&REG_NDMA0SAD)[7 * SDMMC_NDMA_CHANNEL];
+	channel[0] = (u32)src; //SAD
+	channel[1] = SDMMC_BASE + REG_SDFIFO32; //DAD
+	channel[3] = size >> 2; //WCNT
+	channel[4] = NDMABCNT_PRESCALER_1 | NDMABCNT_INTERVAL(0); //BCNT
+	channel[6] = NDMACNT_DST_MODE_FIXED | NDMACNT_SRC_MODE_INCREMENT |
+		NDMACNT_PHYSICAL_COUNT_1 | NDMACNT_MODE_IMMEDIATE | NDMACNT_ENABLE;
+	dma_twlWait(SDMMC_NDMA_CHANNEL);
+}
+#endif
+
 //---------------------------------------------------------------------------------
 int geterror(struct mmcdevice *ctx) {
 //---------------------------------------------------------------------------------
@@ -81,24 +118,17 @@ void sdmmc_send_command(struct mmcdevice *ctx, uint32_t cmd, uint32_t args) {
 					if(size >= blkSize)
 					{
 						#ifdef DATA32_SUPPORT
-						if(!((u32)rDataPtr32 & 3))
+						if(!((u32)rDataPtr8 & 3))
 						{
-							for(u32 i = 0; i < blkSize; i += 4)
-							{
-								*rDataPtr32++ = sdmmc_read32(REG_SDFIFO32);
-							}
+							sdmmc_fifo_read((u32*)rDataPtr8, blkSize);
 						}
 						else
 						{
-							for(u32 i = 0; i < blkSize; i += 4)
-							{
-								u32 data = sdmmc_read32(REG_SDFIFO32);
-								*rDataPtr8++ = data;
-								*rDataPtr8++ = data >> 8;
-								*rDataPtr8++ = data >> 16;
-								*rDataPtr8++ = data >> 24;
-							}
+							// The FIFO and NDMA only move whole words
+							sdmmc_fifo_read(bounceBuf, blkSize);
+							tonccpy(rDataPtr8, bounceBuf, blkSize);
 						}
+						rDataPtr8 += blkSize;
 						#else
 						if(!((u32)rDataPtr16 & 1))
 						{
@@ -138,24 +168,16 @@ void sdmmc_send_command(struct mmcdevice *ctx, uint32_t cmd, uint32_t args) {
 					if(size >= blkSize)
 					{
 						#ifdef DATA32_SUPPORT
-						if(!((u32)tDataPtr32 & 3))
+						if(!((u32)tDataPtr8 & 3))
 						{
-							for(u32 i = 0; i < blkSize; i += 4)
-							{
-								sdmmc_write32(REG_SDFIFO32, *tDataPtr32++);
-							}
+							sdmmc_fifo_write((const u32*)tDataPtr8, blkSize);
 						}
 						else
 						{
-							for(u32 i = 0; i < blkSize; i += 4)
-							{
-								u32 data = *tDataPtr8++;
-								data |= (u32)*tDataPtr8++ << 8;
-								data |= (u32)*tDataPtr8++ << 16;
-								data |= (u32)*tDataPtr8++ << 24;
-								sdmmc_write32(REG_SDFIFO32, data);
-							}
+							tonccpy(bounceBuf, tDataPtr8, blkSize);
+							sdmmc_fifo_write(bounceBuf, blkSize);
 						}
+						tDataPtr8 += blkSize;
 						#else
 						if(!((u32)tDataPtr16 & 1))
 						{
@@ -0,0 +1,501 @@
+// Benchmarks for the arm9 modules that build on a host, see the Makefile.
+// Prints one JSON object per benchmark on stdout, a summary on stderr.
+// Known-answer checks run first, any mismatch fails the run.
+//
+// Usage: hostbench [-f filter] [-r repeats] [-d dir]
+//
+//   -f filter   only run benchmarks with this in their name
+//   -r repeats  runs per benchmark, the fastest counts (default 3)
+//   -d dir      where the scratch files go (default /tmp)
+
+#include <nds.h>
+#include <nds/disc_io.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "imgio.h"
+#include "inifile.h"
+#include "lzss.h"
+#include "nitrofs.h"
+#include "sha1.h"
+
+// Neither has an extern "C" of its own
+extern "C" {
+#include "aes.h"
+#include "crypto.h"
+}
+
+extern "C" char currentImgName[PATH_MAX];
+
+#define SECTOR_SIZE 512
+
+// What one run did, the rate is work / seconds
+struct Result {
+	double work;
+	const char *unit;
+};
+
+struct Check {
+	const char *name;
+	bool (*run)(void);
+};
+
+struct Benchmark {
+	const char *name;
+	const char *unit;
+	std::function<Result(void)> run;
+};
+
+static std::string scratchDir = "/tmp";
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Same every run so results are comparable, roughly as compressible as a
+// ROM: runs, repeated strings and noise
+static std::vector<u8> testData(size_t size) {
+	std::vector<u8> data(size);
+	u32 seed = 0x12345678;
+	size_t i = 0;
+	while (i < size) {
+		seed = seed * 1103515245 + 12345;
+		size_t len = std::min<size_t>(((seed >> 16) & 0xFF) + 1, size - i);
+		switch ((seed >> 8) & 3) {
+			case 0: // run
+				memset(&data[i], seed >> 24, len);
+				break;
+			case 1: // repeat from earlier
+				for (size_t j = 0; j < len; j++)
+					data[i + j] = i >= 1024 ? data[i + j - 1024] : (u8)j;
+				break;
+			default: // noise
+				for (size_t j = 0; j < len; j++) {
+					seed = seed * 1103515245 + 12345;
+					data[i + j] = seed >> 24;
+				}
+				break;
+		}
+		i += len;
+	}
+	return data;
+}
+
+// The _be AES functions take every 16 byte block byte reversed, which is
+// how the console's AES engine sees memory
+static void reverse16(u8 *dst, const u8 *src) {
+	for (int i = 0; i < 16; i++)
+		dst[i] = src[15 - i];
+}
+
+static bool hexEquals(const u8 *data, const char *hex) {
+	for (size_t i = 0; hex[i * 2]; i++) {
+		unsigned byte;
+		if (sscanf(hex + i * 2, "%2x", &byte) != 1 || data[i] != byte)
+			return false;
+	}
+	return true;
+}
+
+// FIPS-197 appendix C.1, through both the single block and the CTR path
+static bool checkAesFips197(void) {
+	static const u8 key[16] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+	static const u8 plain[16] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF};
+	static const char *cipher = "69c4e0d86a7b0430d8cdb78070b4c55a";
+
+	u8 keyBe[16], block[16], result[16];
+	u32 rk[RK_LEN];
+	aes_gen_tables();
+	reverse16(keyBe, key);
+	aes_set_key_enc_128_be(rk, keyBe);
+
+	reverse16(block, plain);
+	aes_encrypt_128_be(rk, block, block);
+	reverse16(result, block);
+	if (!hexEquals(result, cipher))
+		return false;
+
+	// CTR over a zero block with the plaintext as the counter gives the same
+	u32 ctr[4], data[4] = {0, 0, 0, 0};
+	reverse16((u8 *)ctr, plain);
+	aes_ctr_crypt_128_be(rk, ctr, data, data, 1);
+	reverse16(result, (const u8 *)data);
+	return hexEquals(result, cipher);
+}
+
+// A counter that carries across all three low words part way through,
+// in place. Expected keystream from openssl in ECB mode over the counters
+// 00000001fffffffffffffffffffffffe up to 00000002000000000000000000000001.
+static bool checkAesCtrCarry(void) {
+	static const u8 key[16] = {0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C};
+	static const char *keystream[4] = {
+		"49c5628f204f86078f8c29e393f4aefb",
+		"c80966aac9d2eb3dfb9760620c18c4e0",
+		"421fb53959d829863d9a669bc418e3db",
+		"ee94c1cb572626a5e66b139366cae54c",
+	};
+
+	u8 keyBe[16], result[16];
+	u32 rk[RK_LEN];
+	aes_gen_tables();
+	reverse16(keyBe, key);
+	aes_set_key_enc_128_be(rk, keyBe);
+
+	u32 ctr[4] = {0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF, 0x00000001};
+	u32 data[16] = {0};
+	aes_ctr_crypt_128_be(rk, ctr, data, data, 4);
+	for (int i = 0; i < 4; i++) {
+		reverse16(result, (const u8 *)&data[i * 4]);
+		if (!hexEquals(result, keystream[i]))
+			return false;
+	}
+
+	return ctr[0] == 2 && ctr[1] == 0 && ctr[2] == 0 && ctr[3] == 2;
+}
+
+static Result benchSha1(void) {
+	static std::vector<u8> data = testData(16 << 20);
+	char digest[SHA1_LEN];
+	SHA1(digest, (const char *)data.data(), data.size());
+	return {data.size() / 1048576.0, "MB/s"};
+}
+
+static Result benchNandAes(void) {
+	static std::vector<u8> data = testData(4 << 20);
+	static const u8 consoleId[8] = {0x08, 0x20, 0x1A, 0x2B, 0x3C, 0x4D, 0x5E, 0x6F};
+	static const u8 cid[16] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF, 0x00};
+
+	dsi_crypt_init(consoleId, cid, 0);
+	dsi_nand_crypt(data.data(), data.data(), 0, data.size() / AES_BLOCK_SIZE);
+	return {data.size() / 1048576.0, "MB/s"};
+}
+
+// The normal modes search the whole window, so they get a smaller input
+static Result benchLzss(int mode, size_t size) {
+	static std::vector<u8> data = testData(1 << 20);
+	int packedSize;
+	u8 *packed = LZS_Encode(data.data(), size, mode, &packedSize);
+	free(packed);
+	return {size / 1048576.0, "MB/s"};
+}
+
+// A config sized ini, loaded and then looked up a key at a time
+static Result benchIniLoad(void) {
+	std::string path = scratchDir + "/hostbench.ini";
+	static bool written = false;
+	if (!written) {
+		FILE *file = fopen(path.c_str(), "w");
+		if (!file) {
+			perror(path.c_str());
+			exit(1);
+		}
+		for (int section = 0; section < 50; section++) {
+			fprintf(file, "[SECTION_%d]\n", section);
+			for (int key = 0; key < 40; key++)
+				fprintf(file, "KEY_%d=value %d %d\n", key, section, key);
+		}
+		fclose(file);
+		written = true;
+	}
+
+	int loads = 20;
+	for (int i = 0; i < loads; i++) {
+		CIniFile ini(path);
+		for (int section = 0; section < 50; section++) {
+			for (int key = 0; key < 40; key += 4) {
+				ini.GetString("SECTION_" + std::to_string(section), "KEY_" + std::to_string(key), "");
+			}
+		}
+	}
+	return {(double)loads, "loads/s"};
+}
+
+static Result benchIniSet(void) {
+	CIniFile ini;
+	int sets = 0;
+	for (int section = 0; section < 20; section++) {
+		for (int key = 0; key < 100; key++) {
+			ini.SetString("SECTION_" + std::to_string(section), "KEY_" + std::to_string(key), "value");
+			sets++;
+		}
+	}
+	return {(double)sets, "sets/s"};
+}
+
+// A ROM with just a header, FNT and FAT: 65 directories two deep, 40 files
+// in each. Returns the path of every file, FAT sizes are i * 16.
+static std::vector<std::string> nitroWriteRom(const std::string &path) {
+	const int topDirs = 8, subDirs = 7, filesPerDir = 40;
+	const int dirCount = 1 + topDirs + topDirs * subDirs;
+
+	std::vector<std::string> dirPaths(dirCount);
+	std::vector<u16> parents(dirCount);
+	std::vector<std::vector<int>> children(dirCount);
+	dirPaths[0] = "nitro:/";
+	int next = 1;
+	for (int i = 0; i < topDirs; i++) {
+		int top = next++;
+		dirPaths[top] = "dir_" + std::to_string(i);
+		parents[top] = 0;
+		children[0].push_back(top);
+		for (int j = 0; j < subDirs; j++) {
+			int sub = next++;
+			dirPaths[sub] = dirPaths[top] + "/dir_" + std::to_string(i) + "_" + std::to_string(j);
+			parents[sub] = top;
+			children[top].push_back(sub);
+		}
+	}
+
+	auto put16 = [](std::vector<u8> &out, u16 value) {
+		out.push_back(value);
+		out.push_back(value >> 8);
+	};
+	auto put32 = [](std::vector<u8> &out, u32 offset, u32 value) {
+		for (int i = 0; i < 4; i++)
+			out[offset + i] = value >> (i * 8);
+	};
+
+	// Main table first, then each directory's names
+	std::vector<u8> fnt(dirCount * sizeof(ROM_FNTDir));
+	std::vector<std::string> files;
+	for (int dir = 0; dir < dirCount; dir++) {
+		u32 fileId = files.size();
+		put32(fnt, dir * 8, fnt.size());
+		fnt[dir * 8 + 4] = fileId;
+		fnt[dir * 8 + 5] = fileId >> 8;
+		u16 parent = dir == 0 ? dirCount : NITROROOT | parents[dir];
+		fnt[dir * 8 + 6] = parent;
+		fnt[dir * 8 + 7] = parent >> 8;
+
+		std::string prefix = dir == 0 ? "nitro:/" : "nitro:/" + dirPaths[dir] + "/";
+		for (int i = 0; i < filesPerDir; i++) {
+			char name[16];
+			int len = snprintf(name, sizeof(name), "file_%03d.bin", i);
+			fnt.push_back(len);
+			fnt.insert(fnt.end(), name, name + len);
+			files.push_back(prefix + name);
+		}
+		for (int child : children[dir]) {
+			std::string name = dirPaths[child].substr(dirPaths[child].rfind('/') + 1);
+			fnt.push_back(NITROISDIR | name.size());
+			fnt.insert(fnt.end(), name.begin(), name.end());
+			put16(fnt, NITROROOT | child);
+		}
+		fnt.push_back(0);
+	}
+
+	std::vector<u8> fat(files.size() * sizeof(ROM_FAT));
+	for (size_t i = 0; i < files.size(); i++) {
+		put32(fat, i * 8, 0x8000);
+		put32(fat, i * 8 + 4, 0x8000 + i * 16);
+	}
+
+	std::vector<u8> header(0x200);
+	put32(header, FNTOFFSET, header.size());
+	put32(header, FNTSIZEOFFSET, fnt.size());
+	put32(header, FATOFFSET, header.size() + fnt.size());
+	put32(header, FATSIZEOFFSET, fat.size());
+
+	FILE *file = fopen(path.c_str(), "wb");
+	if (!file) {
+		perror(path.c_str());
+		exit(1);
+	}
+	fwrite(header.data(), 1, header.size(), file);
+	fwrite(fnt.data(), 1, fnt.size(), file);
+	fwrite(fat.data(), 1, fat.size(), file);
+	fclose(file);
+
+	return files;
+}
+
+static std::vector<std::string> nitroFiles;
+
+static void nitroMount(void) {
+	std::string path = scratchDir + "/hostbench.nds";
+	if (nitroFiles.empty())
+		nitroFiles = nitroWriteRom(path);
+
+	if (!nitroFSInit(path.c_str())) {
+		fprintf(stderr, "nitrofs couldn't mount %s\n", path.c_str());
+		exit(1);
+	}
+}
+
+// Mounting reads the FNT and FAT in and builds the name index
+static Result benchNitroMount(void) {
+	int mounts = 200;
+	for (int i = 0; i < mounts; i++)
+		nitroMount();
+	return {(double)mounts, "mounts/s"};
+}
+
+// Every file by its full path, as opening or stat()ing them would
+static Result benchNitroLookup(void) {
+	nitroMount();
+	struct _reent r;
+	struct stat st;
+	int lookups = 0;
+	for (int pass = 0; pass < 50; pass++) {
+		for (size_t i = 0; i < nitroFiles.size(); i++, lookups++) {
+			if (nitroFSstat(&r, nitroFiles[i].c_str(), &st) != 0 || st.st_size != (off_t)(i * 16)) {
+				fprintf(stderr, "nitrofs lookup of %s failed\n", nitroFiles[i].c_str());
+				exit(1);
+			}
+		}
+	}
+	return {(double)lookups, "lookups/s"};
+}
+
+// A 32 MB image through imgio's sector cache, the same DISC_INTERFACE the
+// console mounts images with
+#define IMG_SECTORS (64 << 11)
+
+static void imgOpen(void) {
+	snprintf(currentImgName, PATH_MAX, "%s/hostbench.img", scratchDir.c_str());
+	if (access(currentImgName, F_OK) != 0) {
+		FILE *file = fopen(currentImgName, "wb");
+		if (!file) {
+			perror(currentImgName);
+			exit(1);
+		}
+		std::vector<u8> data = testData(1 << 20);
+		for (int i = 0; i < IMG_SECTORS / 2048; i++)
+			fwrite(data.data(), 1, data.size(), file);
+		fclose(file);
+	}
+
+	img_set_cache_size(IMG_CACHE_DEFAULT);
+	img_set_writable(true);
+	if (!io_img.startup()) {
+		fprintf(stderr, "Couldn't open %s\n", currentImgName);
+		exit(1);
+	}
+}
+
+static Result benchImgSequential(void) {
+	static u8 buffer[64 * SECTOR_SIZE];
+	imgOpen();
+	for (sec_t sector = 0; sector < IMG_SECTORS; sector += 64)
+		io_img.readSectors(sector, 64, buffer);
+	io_img.shutdown();
+	return {IMG_SECTORS * SECTOR_SIZE / 1048576.0, "MB/s"};
+}
+
+// What libfat does walking a directory tree, single sectors mostly from a
+// small hot set (FAT, directories) with some file data mixed in
+static Result benchImgRandom(void) {
+	static u8 buffer[SECTOR_SIZE];
+	imgOpen();
+	u32 seed = 1;
+	int reads = 200000;
+	for (int i = 0; i < reads; i++) {
+		seed = seed * 1103515245 + 12345;
+		sec_t sector = (seed >> 8) % 8 ? (seed >> 16) % 128 : (seed >> 8) % IMG_SECTORS;
+		io_img.readSectors(sector, 1, buffer);
+	}
+	io_img.shutdown();
+	return {(double)reads, "reads/s"};
+}
+
+// fcopy()'s 32 KB chunks from the first half of the image to the second
+static Result benchImgCopy(void) {
+	static u8 buffer[0x8000];
+	imgOpen();
+	sec_t chunk = sizeof(buffer) / SECTOR_SIZE;
+	for (sec_t sector = 0; sector < IMG_SECTORS / 2; sector += chunk) {
+		io_img.readSectors(sector, chunk, buffer);
+		io_img.writeSectors(IMG_SECTORS / 2 + sector, chunk, buffer);
+	}
+	io_img.shutdown();
+	return {IMG_SECTORS / 2 * SECTOR_SIZE / 1048576.0, "MB/s"};
+}
+
+int main(int argc, char **argv) {
+	const char *filter = NULL;
+	int repeats = 3;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "f:r:d:")) != -1) {
+		switch (opt) {
+			case 'f':
+				filter = optarg;
+				break;
+			case 'r':
+				repeats = std::max(atoi(optarg), 1);
+				break;
+			case 'd':
+				scratchDir = optarg;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-f filter] [-r repeats] [-d dir]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	const Check checks[] = {
+		{"aes_fips197", checkAesFips197},
+		{"aes_ctr_carry", checkAesCtrCarry},
+	};
+
+	bool passed = true;
+	for (const Check &check : checks) {
+		bool pass = check.run();
+		printf("{\"name\": \"%s\", \"pass\": %s}\n", check.name, pass ? "true" : "false");
+		if (!pass) {
+			fprintf(stderr, "%-20s FAILED\n", check.name);
+			passed = false;
+		}
+	}
+	if (!passed)
+		return 1;
+
+	const Benchmark benchmarks[] = {
+		{"sha1", "MB/s", benchSha1},
+		{"nand_aes", "MB/s", benchNandAes},
+		{"lzss_vfast", "MB/s", [] { return benchLzss(LZS_VFAST, 1 << 20); }},
+		{"lzss_vram", "MB/s", [] { return benchLzss(LZS_VRAM, 64 << 10); }},
+		{"ini_load", "loads/s", benchIniLoad},
+		{"ini_set", "sets/s", benchIniSet},
+		{"nitro_mount", "mounts/s", benchNitroMount},
+		{"nitro_lookup", "lookups/s", benchNitroLookup},
+		{"img_sequential_read", "MB/s", benchImgSequential},
+		{"img_random_read", "reads/s", benchImgRandom},
+		{"img_copy", "MB/s", benchImgCopy},
+	};
+
+	for (const Benchmark &benchmark : benchmarks) {
+		if (filter && !strstr(benchmark.name, filter))
+			continue;
+
+		double best = 0, bestSeconds = 0;
+		Result result = {0, benchmark.unit};
+		for (int i = 0; i < repeats; i++) {
+			double start = now();
+			result = benchmark.run();
+			double seconds = now() - start;
+			if (i == 0 || seconds < bestSeconds) {
+				bestSeconds = seconds;
+				best = result.work / seconds;
+			}
+		}
+
+		printf("{\"name\": \"%s\", \"value\": %.3f, \"unit\": \"%s\", \"seconds\": %.6f, \"repeats\": %d}\n",
+			benchmark.name, best, result.unit, bestSeconds, repeats);
+		fprintf(stderr, "%-20s %12.2f %s\n", benchmark.name, best, result.unit);
+	}
+
+	return 0;
+}
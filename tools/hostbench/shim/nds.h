@@ -0,0 +1,33 @@
+#pragma once
+
+// Just enough of libnds for the arm9 modules tools/hostbench builds. There's
+// no hardware, so anything that would ask the ARM7 reports it as unusable.
+
+#include <nds/ndstypes.h>
+
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BUS_CLOCK 33513982
+
+#define FIFO_USER_08 8
+
+// nitrofs.c's GBA slot path, never taken on the host
+#define GBAROM ((u16 *)0x08000000)
+
+static inline bool isDSiMode(void) { return false; }
+
+static inline void DC_FlushRange(const void *base, u32 size) { (void)base; (void)size; }
+static inline void DC_InvalidateRange(const void *base, u32 size) { (void)base; (void)size; }
+
+static inline bool fifoSendDatamsg(u32 channel, u32 num_bytes, u8 *data_array) { (void)channel; (void)num_bytes; (void)data_array; return true; }
+static inline void fifoWaitValue32(u32 channel) { (void)channel; }
+static inline u32 fifoGetValue32(u32 channel) { (void)channel; return 1; }
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,3 @@
+#pragma once
+
+// Only here for read_card.h, nothing from it is used on the host
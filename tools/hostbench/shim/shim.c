@@ -0,0 +1,18 @@
+#include <nds.h>
+#include <stdio.h>
+#include <stddef.h>
+
+// From arm9/source/utils.c, which needs more of the console than is worth
+// shimming
+void print_bytes(const void *buf, size_t len) {
+	const unsigned char *bytes = buf;
+	for (size_t i = 0; i < len; i++)
+		printf("%02x", bytes[i]);
+}
+
+// nitrofs.c's slot-1 path, never taken on the host
+void cardRead(u32 src, void *dest, bool nandSave) {
+	(void)src;
+	(void)dest;
+	(void)nandSave;
+}
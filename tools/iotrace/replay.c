@@ -0,0 +1,285 @@
+/*
+ * Replays a sector trace recorded with IO_TRACE=1 (gm9i/io_trace.bin)
+ * against a disk image, and reports latency and throughput next to what
+ * was recorded on the console.
+ *
+ * Build: make -C tools/hostbench iotrace-replay
+ * Usage: iotrace-replay [-D drive] [-c sectors] [-d] [-n] trace.bin image.img
+ *
+ *   -D drive    sd, fat, ram, nand or img, by default the busiest one
+ *   -c sectors  imgio's sector cache size, 0 turns it off (default 64)
+ *   -d          drop the image from the page cache first
+ *   -n          skip writes, by default they write back what's already on
+ *               the image so it's left unchanged
+ *
+ * The trace is below libfat, so this replays the same sector requests the
+ * drive's DISC_INTERFACE saw, through the io_img interface the console
+ * mounts images with. Changes to imgio's caching show up here the same as
+ * they would on the console. Requests past the end of the image are
+ * skipped and counted.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "imgio.h"
+#include "iostats.h"
+
+#define SECTOR_SIZE 512
+
+extern char currentImgName[PATH_MAX];
+
+static const char *driveNames[IOSTATS_DRIVES] = {"sd", "fat", "ram", "nand", "img"};
+
+static uint64_t nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int compareU64(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static double mbPerSec(uint64_t bytes, double seconds) {
+	return seconds > 0 ? bytes / seconds / (1024 * 1024) : 0;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "Usage: %s [-D drive] [-c sectors] [-d] [-n] trace.bin image.img\n", name);
+}
+
+int main(int argc, char **argv) {
+	int drive = -1;
+	u32 cacheSectors = IMG_CACHE_DEFAULT;
+	bool dropCache = false, skipWrites = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "D:c:dn")) != -1) {
+		switch (opt) {
+			case 'D':
+				for (int i = 0; i < IOSTATS_DRIVES; i++) {
+					if (strcmp(optarg, driveNames[i]) == 0)
+						drive = i;
+				}
+				if (drive < 0) {
+					fprintf(stderr, "Unknown drive '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'c':
+				cacheSectors = strtoul(optarg, NULL, 0);
+				break;
+			case 'd':
+				dropCache = true;
+				break;
+			case 'n':
+				skipWrites = true;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if (argc - optind != 2) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// Load the whole trace, they're small
+	FILE *traceFile = fopen(argv[optind], "rb");
+	if (!traceFile) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	IoTraceHeader header;
+	if (fread(&header, sizeof(header), 1, traceFile) != 1 || header.magic != IOTRACE_MAGIC
+	 || header.version != IOTRACE_VERSION || header.recordSize != sizeof(IoTraceRecord) || header.tickRate == 0) {
+		fprintf(stderr, "%s: not a version %d trace\n", argv[optind], IOTRACE_VERSION);
+		return 1;
+	}
+
+	size_t recordCount = 0, recordCapacity = 0x1000;
+	IoTraceRecord *records = malloc(recordCapacity * sizeof(IoTraceRecord));
+	while (records && fread(&records[recordCount], sizeof(IoTraceRecord), 1, traceFile) == 1) {
+		if (++recordCount == recordCapacity) {
+			recordCapacity *= 2;
+			records = realloc(records, recordCapacity * sizeof(IoTraceRecord));
+		}
+	}
+	fclose(traceFile);
+	if (!records) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	// Default to whichever drive saw the most requests
+	uint64_t dropped = 0;
+	size_t perDrive[IOSTATS_DRIVES] = {0};
+	for (size_t i = 0; i < recordCount; i++) {
+		if (records[i].flags & IOTRACE_DROPPED)
+			dropped += records[i].count;
+		else if (records[i].drive < IOSTATS_DRIVES)
+			perDrive[records[i].drive]++;
+	}
+	if (drive < 0) {
+		drive = 0;
+		for (int i = 1; i < IOSTATS_DRIVES; i++) {
+			if (perDrive[i] > perDrive[drive])
+				drive = i;
+		}
+	}
+	if (perDrive[drive] == 0) {
+		fprintf(stderr, "No requests for %s in the trace\n", driveNames[drive]);
+		return 1;
+	}
+
+	// Writes put back what's on the image, which is read from here so it
+	// doesn't go through imgio's cache
+	int fd = open(argv[optind + 1], O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		perror(argv[optind + 1]);
+		return 1;
+	}
+	uint64_t imageSectors = st.st_size / SECTOR_SIZE;
+	if (dropCache)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+	snprintf(currentImgName, PATH_MAX, "%s", argv[optind + 1]);
+	img_set_cache_size(cacheSectors);
+	img_set_writable(!skipWrites);
+	if (!io_img.startup()) {
+		fprintf(stderr, "%s: imgio couldn't open it\n", argv[optind + 1]);
+		return 1;
+	}
+
+	uint32_t maxCount = 0;
+	for (size_t i = 0; i < recordCount; i++) {
+		if (records[i].drive == drive && !(records[i].flags & IOTRACE_DROPPED) && records[i].count > maxCount)
+			maxCount = records[i].count;
+	}
+
+	// Aligned the same as libfat's buffers on the console
+	void *buffer;
+	if (posix_memalign(&buffer, 32, (size_t)maxCount * SECTOR_SIZE) != 0) {
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	uint64_t *latencies = malloc(perDrive[drive] * sizeof(uint64_t));
+	size_t latencyCount = 0, skipped = 0, failed = 0, recordedFailures = 0;
+	uint64_t bytesRead = 0, bytesWritten = 0, recordedTicks = 0, replayNs = 0;
+	uint64_t recordedSpan = 0, firstStart = 0, lastEnd = 0, wraps = 0;
+	uint32_t prevStart = 0;
+	size_t seen = 0;
+	size_t histogram[IOSTATS_SIZE_BUCKETS] = {0};
+
+	for (size_t i = 0; i < recordCount; i++) {
+		const IoTraceRecord *record = &records[i];
+		if (record->drive != drive || (record->flags & IOTRACE_DROPPED))
+			continue;
+
+		// The console's timer wraps, requests are in order so unwrap it
+		if (seen > 0 && record->start < prevStart)
+			wraps++;
+		prevStart = record->start;
+		uint64_t start = (wraps << 32) | record->start;
+		if (seen++ == 0)
+			firstStart = start;
+		lastEnd = start + record->ticks;
+
+		if (record->flags & IOTRACE_FAILED)
+			recordedFailures++;
+
+		if ((uint64_t)record->sector + record->count > imageSectors) {
+			skipped++;
+			continue;
+		}
+
+		bool write = record->flags & IOTRACE_WRITE;
+		if (write && skipWrites) {
+			skipped++;
+			continue;
+		}
+
+		// Writes put back what's there, read outside the timed part
+		size_t size = (size_t)record->count * SECTOR_SIZE;
+		if (write && pread(fd, buffer, size, (off_t)record->sector * SECTOR_SIZE) != (ssize_t)size) {
+			failed++;
+			continue;
+		}
+
+		uint64_t begin = nowNs();
+		bool success = write ? io_img.writeSectors(record->sector, record->count, buffer)
+		                     : io_img.readSectors(record->sector, record->count, buffer);
+		uint64_t elapsed = nowNs() - begin;
+
+		if (!success) {
+			failed++;
+			continue;
+		}
+
+		latencies[latencyCount++] = elapsed;
+		replayNs += elapsed;
+		recordedTicks += record->ticks;
+		*(write ? &bytesWritten : &bytesRead) += (uint64_t)record->count * SECTOR_SIZE;
+
+		int bucket = 0;
+		while (bucket < IOSTATS_SIZE_BUCKETS - 1 && (record->count >> (bucket + 1)) != 0)
+			bucket++;
+		histogram[bucket]++;
+	}
+	recordedSpan = lastEnd - firstStart;
+
+	// Dirty cached sectors only reach the image here, so it counts too
+	uint64_t flushBegin = nowNs();
+	if (!io_img.shutdown())
+		failed++;
+	uint64_t flushNs = nowNs() - flushBegin;
+	close(fd);
+
+	if (latencyCount == 0) {
+		fprintf(stderr, "Nothing was replayed, %zu requests skipped and %zu failed\n", skipped, failed);
+		return 1;
+	}
+
+	qsort(latencies, latencyCount, sizeof(uint64_t), compareU64);
+	uint64_t bytes = bytesRead + bytesWritten;
+	double recordedBusy = (double)recordedTicks / header.tickRate;
+	double recordedWall = (double)recordedSpan / header.tickRate;
+	double replaySeconds = (replayNs + flushNs) / 1e9;
+
+	printf("drive            %s\n", driveNames[drive]);
+	printf("requests         %zu replayed, %zu skipped, %zu failed, %zu failed when recorded\n", latencyCount, skipped, failed, recordedFailures);
+	if (dropped > 0)
+		printf("dropped          %llu requests weren't recorded, the trace buffer was full\n", (unsigned long long)dropped);
+	printf("data             %.2f MB read, %.2f MB written\n", bytesRead / 1048576.0, bytesWritten / 1048576.0);
+	printf("recorded         %.3f s busy of %.3f s, %.2f MB/s while busy, %.1f us mean\n",
+		recordedBusy, recordedWall, mbPerSec(bytes, recordedBusy), recordedBusy * 1e6 / latencyCount);
+	printf("replayed         %.3f s, %.2f MB/s, %.1f us mean, %u sector cache\n", replaySeconds, mbPerSec(bytes, replaySeconds), replayNs / 1e3 / latencyCount, (unsigned)cacheSectors);
+	printf("flush            %.1f us\n", flushNs / 1e3);
+	printf("latency (us)     p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+		latencies[latencyCount / 2] / 1e3, latencies[latencyCount * 9 / 10] / 1e3,
+		latencies[latencyCount * 99 / 100] / 1e3, latencies[latencyCount - 1] / 1e3);
+	printf("sizes (sectors) ");
+	for (int i = 0; i < IOSTATS_SIZE_BUCKETS; i++)
+		printf(" %d%s:%zu", 1 << i, i == IOSTATS_SIZE_BUCKETS - 1 ? "+" : "", histogram[i]);
+	printf("\n");
+
+	free(latencies);
+	free(buffer);
+	free(records);
+	return 0;
+}
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""
+Compiles a language.ini into the binary string table language.cpp loads
+in place of parsing the ini.
+
+Usage: langpack.py language.inl language.ini language.bin
+
+The layout must match langLoadPack() in arm9/source/language.cpp:
+
+  char magic[4]    "GM9L"
+  u16  version     2
+  u16  count       number of strings, in language.inl order
+  u32  idHash      FNV-1a of the string names, one per line
+  u32  iniSize     size of the source ini, to spot a stale pack
+  u32  iniHash     FNV-1a of the source ini, for edits that keep the size
+  u32  flags       bit 0: right to left
+  u32  offsets[count]
+  char data[]      NUL terminated UTF-8, offsets are from the start of data
+
+Escapes are resolved the same way as getString() does for an ini, to the
+button glyphs in the private use area. Strings missing from the ini get
+the default from language.inl.
+"""
+
+import codecs
+import re
+import struct
+import sys
+
+VERSION = 2
+FLAG_RTL = 1
+
+GLYPHS = {
+	"a": "\uE000",
+	"b": "\uE001",
+	"x": "\uE002",
+	"y": "\uE003",
+	"l": "\uE004",
+	"r": "\uE005",
+}
+
+DPAD_GLYPHS = {
+	"u": "\uE079",
+	"d": "\uE07A",
+	"l": "\uE07B",
+	"r": "\uE07C",
+	"v": "\uE07D",
+	"h": "\uE07E",
+}
+
+
+def fnv1a(data):
+	h = 0x811C9DC5
+	for byte in data:
+		h ^= byte
+		h = (h * 0x01000193) & 0xFFFFFFFF
+	return h
+
+
+def read_inl(path):
+	"""Returns [(name, default)] in the order of language.inl"""
+	strings = []
+	with open(path, "rb") as f:
+		for line in f:
+			match = re.match(rb'\s*STRING\((\w+),\s*"(.*)"\)\s*$', line)
+			if match:
+				# The defaults are C string literals
+				default = codecs.escape_decode(match.group(2))[0].decode("utf-8")
+				strings.append((match.group(1).decode("ascii"), default))
+	return strings
+
+
+def read_ini(path):
+	"""Returns ({section: {key: value}}, size, hash), first of any duplicates wins like CIniFile"""
+	with open(path, "rb") as f:
+		data = f.read()
+
+	sections = {}
+	section = None
+	text = data[3:] if data.startswith(b"\xEF\xBB\xBF") else data
+	for line in re.split(rb"[\r\n]+", text):
+		line = line.decode("utf-8").strip(" \t")
+		if not line or line[0] in ";/!":
+			continue
+
+		if section is not None and "=" in line:
+			key, value = line.split("=", 1)
+			section.setdefault(key.rstrip(" \t"), value.lstrip(" \t"))
+		elif line[0] == "[":
+			end = line.find("]")
+			section = None
+			if end > 0 and line[1:end] not in sections:
+				section = sections[line[1:end]] = {}
+
+	return sections, len(data), fnv1a(data)
+
+
+def unescape(text):
+	out = []
+	i = 0
+	while i < len(text):
+		c = text[i]
+		next = text[i + 1].lower() if i + 1 < len(text) else ""
+		if c == "\\" and next == "n":
+			out.append("\n")
+			i += 2
+		elif c == "\\" and next in GLYPHS:
+			out.append(GLYPHS[next])
+			i += 2
+		elif c == "\\" and next == "d":
+			after = text[i + 2].lower() if i + 2 < len(text) else ""
+			if after in DPAD_GLYPHS:
+				out.append(DPAD_GLYPHS[after])
+				i += 3
+			else:
+				out.append("\uE006")
+				i += 2
+		elif c == "&" and text[i + 1:i + 4] == "lrm":
+			out.append("\u200E") # Left-to-Right mark
+			i += 4
+		elif c == "&" and text[i + 1:i + 4] == "rlm":
+			out.append("\u200F") # Right-to-Left mark
+			i += 4
+		else:
+			out.append(c)
+			i += 1
+	return "".join(out)
+
+
+def main():
+	if len(sys.argv) != 4:
+		print(__doc__.strip().splitlines()[2])
+		return 1
+
+	inlPath, iniPath, outPath = sys.argv[1:]
+	strings = read_inl(inlPath)
+	sections, iniSize, iniHash = read_ini(iniPath)
+	language = sections.get("LANGUAGE", {})
+	rtl = sections.get("PROPERTIES", {}).get("DIR", "ltr") == "rtl"
+
+	idHash = fnv1a("".join(name + "\n" for name, _ in strings).encode("ascii"))
+
+	offsets = []
+	data = bytearray()
+	for name, default in strings:
+		offsets.append(len(data))
+		data += unescape(language.get(name, default)).encode("utf-8") + b"\0"
+
+	with open(outPath, "wb") as f:
+		f.write(b"GM9L")
+		f.write(struct.pack("<HHIIII", VERSION, len(strings), idHash, iniSize, iniHash, FLAG_RTL if rtl else 0))
+		f.write(struct.pack("<%dI" % len(offsets), *offsets))
+		f.write(data)
+
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())